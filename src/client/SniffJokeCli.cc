@@ -172,6 +172,8 @@ void SniffJokeCli::resolveWeight(char *buf, size_t len, uint32_t weight)
         { AGG_LONGPEEK, AGG_N_LONGPEEK},
         { AGG_NONE, AGG_N_NONE},
         { AGG_HEAVY, AGG_N_HEAVY},
+        { AGG_HANDSHAKE, AGG_N_HANDSHAKE},
+        { AGG_BULKDECAY, AGG_N_BULKDECAY},
         { 0, NULL}
     };
 
@@ -241,6 +243,12 @@ bool SniffJokeCli::parse_SjinternalProto(uint8_t *recvd, uint32_t rcvdlen)
     case TTLMAP_COMMAND_TYPE:
         printf("received (%d bytes) confirm of TTL MAP command\n", rcvdlen);
         return printSJTTL(&recvd[sizeof (blockInfo)], rcvdlen - sizeof (blockInfo));
+    case HOLDSTAT_COMMAND_TYPE:
+        printf("received (%d bytes) confirm of HOLD STAT command\n", rcvdlen);
+        return printSJHoldStat(&recvd[sizeof (blockInfo)], rcvdlen - sizeof (blockInfo));
+    case BUDGET_COMMAND_TYPE:
+        printf("received (%d bytes) confirm of BUDGET command\n", rcvdlen);
+        return printSJBudget(&recvd[sizeof (blockInfo)], rcvdlen - sizeof (blockInfo));
     case COMMAND_ERROR_MSG:
         printf("received (%d bytes) error in command sent\n", rcvdlen);
         return printSJError(&recvd[sizeof (blockInfo)], rcvdlen - sizeof (blockInfo));
@@ -345,6 +353,10 @@ bool SniffJokeCli::printSJStat(const uint8_t *statblock, uint32_t blocklen)
             boolvar = (bool)(*(uint8_t *) pointed_data);
             printf("hack chaining:\t\t%s\n", boolvar ? "enabled" : "disabled");
             break;
+        case STAT_OPTIMISTIC:
+            boolvar = (bool)(*(uint8_t *) pointed_data);
+            printf("optimistic mode:\t%s\n", boolvar ? "enabled" : "disabled");
+            break;
         case STAT_NO_TCP:
             boolvar = (bool)(*(uint8_t *) pointed_data);
             printf("tcp mangling:\t\t%s\n", boolvar ? "disabled" : "enabled");
@@ -435,6 +447,60 @@ bool SniffJokeCli::printSJTTL(const uint8_t *received, uint32_t rcvdlen)
     return true;
 }
 
+bool SniffJokeCli::printSJHoldStat(const uint8_t *received, uint32_t rcvdlen)
+{
+    struct hold_record *hr;
+    uint32_t total = 0, i = 0, prev_ms = 0;
+
+    while (i + sizeof (struct hold_record) <= rcvdlen)
+    {
+        hr = (struct hold_record *) &received[i];
+
+        if (hr->upto_ms)
+            printf(" %5u - %5u ms: %u\n", prev_ms, hr->upto_ms, hr->packets);
+        else
+            printf(" %5u -   ... ms: %u\n", prev_ms, hr->packets);
+
+        prev_ms = hr->upto_ms;
+        total += hr->packets;
+        i += sizeof (struct hold_record);
+    }
+
+    if (!total)
+        printf("no packets have been held waiting the ttl bruteforce\n");
+
+    return true;
+}
+
+bool SniffJokeCli::printSJBudget(const uint8_t *received, uint32_t rcvdlen)
+{
+    struct budget_record *br;
+    char tokens[SMALLBUF];
+    uint32_t cnt = 1, i = 0;
+
+    while (i + sizeof (struct budget_record) <= rcvdlen)
+    {
+        br = (struct budget_record *) &received[i];
+
+        if (br->tokens == 0xffffffff)
+            snprintf(tokens, sizeof (tokens), "unlimited");
+        else
+            snprintf(tokens, sizeof (tokens), "%u bytes", br->tokens);
+
+        if (!i)
+            printf(" global: available %s, injected %u bytes, %u hacks refused\n",
+                   tokens, br->injected, br->refused);
+        else
+            printf(" %02d) %s: available %s, injected %u bytes, %u hacks refused\n",
+                   cnt++, inet_ntoa(*((struct in_addr *) &(br->daddr))),
+                   tokens, br->injected, br->refused);
+
+        i += sizeof (struct budget_record);
+    }
+
+    return true;
+}
+
 bool SniffJokeCli::printSJPort(const uint8_t *statblock, uint32_t blocklen)
 {
     char resolvedInfo[MEDIUMBUF];
@@ -60,6 +60,8 @@ private:
     bool printSJError(const uint8_t *, uint32_t);
     bool printSJSessionInfo(const uint8_t *, uint32_t);
     bool printSJTTL(const uint8_t *, uint32_t);
+    bool printSJHoldStat(const uint8_t *, uint32_t);
+    bool printSJBudget(const uint8_t *, uint32_t);
 
 public:
     SniffJokeCli(const char *, uint16_t, uint32_t);
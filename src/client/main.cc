@@ -49,6 +49,8 @@ static void sjcli_version(const char *pname)
 	" stat\t\t\tget statistics about sniffjoke configuration and network\n"\
 	" info\t\t\tget statistics about sniffjoke active sessions\n"\
 	" ttlmap\t\t\tshow the mapped hop count for destination\n"\
+	" holdstat\t\tshow the histogram of the time packets waited the ttl bruteforce\n"\
+	" budget\t\t\tshow the injection budget, global and for every destination\n"\
 	" showport\t\tshow the running port-aggressivity configuration\n"\
 	" set start:end value\tset the injection's strogness over selected port [not supported!]\n"\
     "\t\tneed to be set in port-aggressivity.conf\n"\
@@ -115,6 +117,8 @@ int main(int argc, char **argv)
         { "saveconf", 1},
         { "info", 1},
         { "ttlmap", 1},
+        { "holdstat", 1},
+        { "budget", 1},
         { "stat", 1},
         { "showport", 1},
         { "set", 3},
@@ -59,6 +59,10 @@ public:
     HDRoptions_probe() :
     Plugin(PLUGIN_NAME, AGG_ALWAYS)
     {
+        acceptedProtos = PKTCLASS_TCP;
+        acceptedPayloads = PKTCLASS_LARGE;
+        acceptedChains = PKTCLASS_CHAIN(HACKUNASSIGNED) | PKTCLASS_CHAIN(REHACKABLE);
+
         sjOptIndex = SUPPORTED_OPTIONS; /* the index really valid is SUPPORTED_OPTIONS -1
                                            so this way on error we will trigger an exception  */
     }
@@ -170,7 +174,7 @@ public:
                    origpkt.SjPacketId);
 
         upgradeChainFlag(pkt);
-        pktVector.push_back(pkt);
+        injectPacket(pkt);
     }
 };
 
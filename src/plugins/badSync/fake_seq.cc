@@ -45,6 +45,10 @@ public:
     fake_seq() :
     Plugin(PLUGIN_NAME, AGG_TIMEBASED5S)
     {
+        acceptedProtos = PKTCLASS_TCP;
+        acceptedFlags = PKTCLASS_ACK | PKTCLASS_NOFLAGS;
+        acceptedPayloads = PKTCLASS_SMALL | PKTCLASS_LARGE;
+        acceptedChains = PKTCLASS_CHAIN(HACKUNASSIGNED) | PKTCLASS_CHAIN(REHACKABLE);
     };
 
     virtual bool init(uint8_t configuredScramble, char *pluginOption, struct sjEnviron *sjE)
@@ -55,31 +59,32 @@ public:
 
     virtual bool condition(const Packet &origpkt, uint8_t availableScrambles)
     {
-        if (origpkt.chainflag == FINALHACK)
+        if (origpkt.chainflag == FINALHACK || !ConstTcpView::match(origpkt))
             return false;
 
-        return (origpkt.fragment == false &&
-                origpkt.proto == TCP &&
-                !origpkt.tcp->syn &&
-                !origpkt.tcp->rst &&
-                !origpkt.tcp->fin &&
-                origpkt.tcppayload != NULL);
+        const ConstTcpView orig(origpkt);
+
+        return (!orig.hdr()->syn &&
+                !orig.hdr()->rst &&
+                !orig.hdr()->fin &&
+                orig.payload() != NULL);
     }
 
     virtual void apply(const Packet &origpkt, uint8_t availableScrambles)
     {
         Packet * const pkt = new Packet(origpkt);
+        const TcpView view(*pkt);
 
         pkt->randomizeID();
 
         /* under test the anticipation seq only */
-        pkt->tcp->seq = htonl(ntohl(pkt->tcp->seq) + (random() % 5000) + 300);
-        /* pkt->tcp->seq = htonl(ntohl(pkt->tcp->seq) - (random() % 5000)); */
+        view.hdr()->seq = htonl(ntohl(view.hdr()->seq) + (sj_random() % 5000) + 300);
+        /* view.hdr()->seq = htonl(ntohl(view.hdr()->seq) - (sj_random() % 5000)); */
 
-        pkt->tcp->window = htons((random() % 80) * 64);
-        pkt->tcp->ack = pkt->tcp->ack_seq = 0;
+        view.hdr()->window = htons((sj_random() % 80) * 64);
+        view.hdr()->ack = view.hdr()->ack_seq = 0;
 
-        uint16_t newpayloadlen = random() % 100 + 200;
+        uint16_t newpayloadlen = sj_random() % 100 + 200;
 
         pkt->tcppayloadResize(newpayloadlen);
         pkt->tcppayloadRandomFill();
@@ -91,7 +96,7 @@ public:
 
         upgradeChainFlag(pkt);
 
-        pktVector.push_back(pkt);
+        injectPacket(pkt);
     }
 };
 
@@ -46,6 +46,9 @@ public:
     fake_window() :
     Plugin(PLUGIN_NAME, AGG_ALWAYS)
     {
+        acceptedProtos = PKTCLASS_TCP;
+        acceptedFlags = PKTCLASS_ACK | PKTCLASS_NOFLAGS;
+        acceptedChains = PKTCLASS_CHAIN(HACKUNASSIGNED);
     };
 
     virtual bool init(uint8_t configuredScramble, char *pluginOption, struct sjEnviron *sjE)
@@ -56,41 +59,42 @@ public:
 
     virtual bool condition(const Packet &origpkt, uint8_t availableScrambles)
     {
-        if (origpkt.chainflag != HACKUNASSIGNED)
+        if (origpkt.chainflag != HACKUNASSIGNED || !ConstTcpView::match(origpkt))
             return false;
 
-        return (origpkt.fragment == false &&
-                origpkt.proto == TCP &&
-                !origpkt.tcp->syn &&
-                !origpkt.tcp->rst &&
-                !origpkt.tcp->fin);
+        const ConstTcpView orig(origpkt);
+
+        return (!orig.hdr()->syn &&
+                !orig.hdr()->rst &&
+                !orig.hdr()->fin);
     }
 
     virtual void apply(const Packet &origpkt, uint8_t availableScrambles)
     {
         Packet * const pkt = new Packet(origpkt);
+        const TcpView view(*pkt);
 
         pkt->randomizeID();
 
         /* all to re - do */
         if (random_percent(50))
-            pkt->tcp->window = 0; /* ZERO WINDOW */
+            view.hdr()->window = 0; /* ZERO WINDOW */
         else
-            memset_random(&(pkt->tcp->window), sizeof (pkt->tcp->window)); /* WINDOW UPDATE */
+            memset_random(&(view.hdr()->window), sizeof (view.hdr()->window)); /* WINDOW UPDATE */
 
         /* a zero/update window could ack segments */
         if (random_percent(66))
         {
-            pkt->tcp->ack = 1;
-            memset_random(&(pkt->tcp->ack_seq), sizeof (pkt->tcp->ack_seq));
+            view.hdr()->ack = 1;
+            memset_random(&(view.hdr()->ack_seq), sizeof (view.hdr()->ack_seq));
         }
         else
         {
-            pkt->tcp->ack = 0;
-            pkt->tcp->ack_seq = 0;
+            view.hdr()->ack = 0;
+            view.hdr()->ack_seq = 0;
         }
 
-        pkt->tcp->psh = 0;
+        view.hdr()->psh = 0;
 
         pkt->tcppayloadResize(0);
 
@@ -101,7 +105,7 @@ public:
 
         upgradeChainFlag(pkt);
 
-        pktVector.push_back(pkt);
+        injectPacket(pkt);
     }
 };
 
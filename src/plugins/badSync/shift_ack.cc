@@ -48,6 +48,9 @@ public:
     shift_ack() :
     Plugin(PLUGIN_NAME, AGG_RARE)
     {
+        acceptedProtos = PKTCLASS_TCP;
+        acceptedFlags = PKTCLASS_ACK;
+        acceptedChains = PKTCLASS_CHAIN(HACKUNASSIGNED) | PKTCLASS_CHAIN(REHACKABLE);
     }
 
     virtual bool init(uint8_t configuredScramble, char *pluginOption, struct sjEnviron *sjE)
@@ -58,24 +61,25 @@ public:
 
     virtual bool condition(const Packet &origpkt, uint8_t availableScrambles)
     {
-        if (origpkt.chainflag == FINALHACK)
+        if (origpkt.chainflag == FINALHACK || !ConstTcpView::match(origpkt))
             return false;
 
-        return (origpkt.fragment == false &&
-                origpkt.proto == TCP &&
-                !origpkt.tcp->syn &&
-                !origpkt.tcp->rst &&
-                !origpkt.tcp->fin &&
-                origpkt.tcp->ack);
+        const ConstTcpView orig(origpkt);
+
+        return (!orig.hdr()->syn &&
+                !orig.hdr()->rst &&
+                !orig.hdr()->fin &&
+                orig.hdr()->ack);
     }
 
     virtual void apply(const Packet &origpkt, uint8_t availableScrambles)
     {
         Packet * const pkt = new Packet(origpkt);
+        const TcpView view(*pkt);
 
         pkt->randomizeID();
 
-        pkt->tcp->ack_seq = htonl(ntohl(pkt->tcp->ack_seq) - pkt->maxMTU() + random() % 2 * pkt->maxMTU());
+        view.hdr()->ack_seq = htonl(ntohl(view.hdr()->ack_seq) - pkt->maxMTU() + sj_random() % 2 * pkt->maxMTU());
 
         pkt->source = PLUGIN;
         pkt->position = ANY_POSITION;
@@ -85,7 +89,7 @@ public:
 
         upgradeChainFlag(pkt);
 
-        pktVector.push_back(pkt);
+        injectPacket(pkt);
     }
 };
 
@@ -63,6 +63,9 @@ public:
     Plugin(PLUGIN_NAME, AGG_PACKETS30PEEK),
     pLH(PLUGIN_NAME, PKT_LOG)
     {
+        acceptedProtos = PKTCLASS_TCP;
+        acceptedFlags = PKTCLASS_ACK | PKTCLASS_NOFLAGS;
+        acceptedChains = PKTCLASS_CHAIN(HACKUNASSIGNED) | PKTCLASS_CHAIN(REHACKABLE);
     }
 
     virtual bool init(uint8_t configuredScramble, char *pluginOption, struct sjEnviron *sjE)
@@ -121,7 +124,7 @@ public:
 
         pkt->chainflag = FINALHACK;
 
-        pktVector.push_back(pkt);
+        injectPacket(pkt);
     }
 
     virtual void apply(const Packet &origpkt, uint8_t availableScrambles)
@@ -66,6 +66,9 @@ public:
     Plugin(PLUGIN_NAME, AGG_PACKETS30PEEK),
     pLH(PLUGIN_NAME, PKT_LOG)
     {
+        acceptedProtos = PKTCLASS_TCP;
+        acceptedFlags = PKTCLASS_ACK | PKTCLASS_NOFLAGS;
+        acceptedChains = PKTCLASS_CHAIN(HACKUNASSIGNED) | PKTCLASS_CHAIN(REHACKABLE);
     };
 
     virtual bool init(uint8_t configuredScramble, char *pluginOption, struct sjEnviron *sjE)
@@ -133,7 +136,7 @@ public:
 
         pkt->chainflag = FINALHACK;
 
-        pktVector.push_back(pkt);
+        injectPacket(pkt);
     }
 };
 
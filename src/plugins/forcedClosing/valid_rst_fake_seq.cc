@@ -67,6 +67,9 @@ public:
     Plugin(PLUGIN_NAME, AGG_PACKETS30PEEK),
     pLH(PLUGIN_NAME, PKT_LOG)
     {
+        acceptedProtos = PKTCLASS_TCP;
+        acceptedFlags = PKTCLASS_ACK | PKTCLASS_NOFLAGS;
+        acceptedChains = PKTCLASS_CHAIN(HACKUNASSIGNED) | PKTCLASS_CHAIN(REHACKABLE);
     };
 
     virtual bool init(uint8_t configuredScramble, char *pluginOption, struct sjEnviron *sjE)
@@ -127,7 +130,7 @@ public:
         pkt->randomizeID();
 
         pkt->tcp->rst = 1;
-        pkt->tcp->seq = htonl(ntohl(pkt->tcp->seq) + (65535 * 5) + (random() % 65535) );
+        pkt->tcp->seq = htonl(ntohl(pkt->tcp->seq) + (65535 * 5) + (sj_random() % 65535) );
         pkt->tcp->window = htons((uint16_t) (-1));
 
         /* tcp->ack and tcp->ack_seq is kept untouched */
@@ -146,7 +149,7 @@ public:
            is an INNOCENT RST based on the seq... */
         pkt->chainflag = FINALHACK;
 
-        pktVector.push_back(pkt);
+        injectPacket(pkt);
     }
 };
 
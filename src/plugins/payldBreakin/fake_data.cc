@@ -74,7 +74,7 @@ private:
         if (random_percent(50))
         {
             pkt->tcp->urg = 1;
-            pkt->tcp->urg_ptr = pkt->tcp->seq << random() % 5;
+            pkt->tcp->urg_ptr = pkt->tcp->seq << sj_random() % 5;
         }
         else
         {
@@ -96,6 +96,9 @@ public:
 
     fake_data() : Plugin(PLUGIN_NAME, AGG_COMMON)
     {
+        acceptedProtos = PKTCLASS_TCP | PKTCLASS_UDP | PKTCLASS_FRAGMENT;
+        acceptedPayloads = PKTCLASS_SMALL | PKTCLASS_LARGE;
+        acceptedChains = PKTCLASS_CHAIN(HACKUNASSIGNED) | PKTCLASS_CHAIN(REHACKABLE);
     };
 
     virtual bool init(uint8_t configuredScramble, char *pluginOption, struct sjEnviron *sjE)
@@ -162,7 +165,7 @@ public:
 
             upgradeChainFlag(pkt);
 
-            pktVector.push_back(pkt);
+            injectPacket(pkt);
         }
     }
 };
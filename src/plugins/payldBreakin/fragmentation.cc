@@ -74,6 +74,9 @@ public:
     Plugin(PLUGIN_NAME, AGG_ALWAYS),
     pLH(PLUGIN_NAME, PKT_LOG)
     {
+        acceptedProtos = PKTCLASS_TCP;
+        acceptedPayloads = PKTCLASS_LARGE;
+        acceptedChains = PKTCLASS_CHAIN(HACKUNASSIGNED) | PKTCLASS_CHAIN(REHACKABLE);
     }
 
     virtual bool init(uint8_t configuredScramble, char *pluginOption, struct sjEnviron *sjE)
@@ -169,7 +172,7 @@ public:
 
             fragPkt->ip->frag_off |= htons(IP_MF);
 
-            pktVector.push_back(fragPkt);
+            injectPacket(fragPkt);
 
             start += fragDataLen;
             tobesend -= fragDataLen;
@@ -182,7 +185,7 @@ public:
 
         fragPkt->ip->frag_off = htons( (start >> 3) & IP_OFFMASK);
 
-        pktVector.push_back(fragPkt);
+        injectPacket(fragPkt);
 
         pLH.completeLog("final fragment (Sj#%u) size %d start %d (frag_off %u) orig seq %u", 
                         fragPkt->SjPacketId, fragPkt->pbuf.size(), start,
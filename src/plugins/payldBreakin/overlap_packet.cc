@@ -76,7 +76,7 @@ private:
         if(newTcplen != ret->tcppayloadlen)
         {
             ret->tcppayloadResize(newTcplen);
-            memset_random(ret->tcppayload, newTcplen);
+            ret->tcppayloadRandomFill();
         }
 
         if(!psh)
@@ -119,6 +119,14 @@ public:
     Plugin(PLUGIN_NAME, AGG_RARE),
     pLH(PLUGIN_NAME, PKT_LOG)
     {
+        acceptedProtos = PKTCLASS_TCP;
+        acceptedFlags = PKTCLASS_ACK | PKTCLASS_FIN | PKTCLASS_NOFLAGS;
+        acceptedPayloads = PKTCLASS_LARGE;
+        acceptedChains = PKTCLASS_CHAIN(HACKUNASSIGNED);
+
+        /* mangleIncoming handles only the answers of the http servers */
+        incomingProtos = PKTCLASS_TCP;
+        incomingPort = 80;
     }
 
     virtual bool init(uint8_t configuredScramble, char *pluginOption, struct sjEnviron *sjE)
@@ -179,19 +187,19 @@ public:
     {
         Packet * const pkt1 = create_segment(origpkt, 0, 60, false, false, true);
         pkt1->position = ANTICIPATION;
-        pktVector.push_back(pkt1);
+        injectPacket(pkt1);
 
         Packet * const pkt2 = create_segment(origpkt, 40, 80, true, false, false);
         pkt2->position = ANTICIPATION;
-        pktVector.push_back(pkt2);
+        injectPacket(pkt2);
 
         Packet * const pkt3 = create_segment(origpkt, 0, origpkt.tcppayloadlen, false, true, false);
         pkt3->position = ANTICIPATION;
-        pktVector.push_back(pkt3);
+        injectPacket(pkt3);
 
         Packet * const pkt4 = create_segment(origpkt, 120, 80, false, false, false);
         pkt4->position = POSTICIPATION;
-        pktVector.push_back(pkt4);
+        injectPacket(pkt4);
 
         removeOrigPkt = true;
     }
@@ -72,6 +72,13 @@ public:
     Plugin(PLUGIN_NAME, AGG_RARE),
     pLH(PLUGIN_NAME, PKT_LOG)
     {
+        acceptedProtos = PKTCLASS_TCP;
+        acceptedFlags = PKTCLASS_ACK | PKTCLASS_NOFLAGS;
+        acceptedPayloads = PKTCLASS_LARGE;
+        acceptedChains = PKTCLASS_CHAIN(HACKUNASSIGNED) | PKTCLASS_CHAIN(REHACKABLE);
+
+        /* the incoming packets are checked only in the flows segmented by apply() */
+        incomingProtos = 0;
     };
 
     virtual bool init(uint8_t configuredScramble, char *pluginOption, struct sjEnviron *sjE)
@@ -116,7 +123,7 @@ public:
          * due to the ratio: MIN_TCP_PAYLOAD = (MIN_SPLIT_PKTS * MIN_SPLIT_PAYLOAD)
          * the hack will produce pkts between a min of MIN_SPLIT_PKTS and a max of MAX_SPLIT_PKTS
          */
-        uint8_t pkts_n = MIN_SPLIT_PKTS + random() % (MAX_SPLIT_PKTS - (MIN_SPLIT_PKTS - 1));
+        uint8_t pkts_n = MIN_SPLIT_PKTS + sj_random() % (MAX_SPLIT_PKTS - (MIN_SPLIT_PKTS - 1));
         uint32_t split_size = origpkt.tcppayloadlen / pkts_n;
         split_size = split_size > MIN_SPLIT_PAYLOAD ? split_size : MIN_SPLIT_PAYLOAD;
         pkts_n = (origpkt.tcppayloadlen / split_size) + ((origpkt.tcppayloadlen % split_size) ? 1 : 0);
@@ -160,8 +167,8 @@ public:
                 resizeAndCopy = carry;
             }
 
-            pkt->tcppayloadResize(resizeAndCopy);
-            memcpy(pkt->tcppayload, &origpkt.tcppayload[pkts * split_size], resizeAndCopy);
+            /* the copy sums the slice too: fixSum() will not read it again */
+            pkt->payloadCopy(&origpkt.tcppayload[pkts * split_size], resizeAndCopy);
 
             pkt->source = PLUGIN;
 
@@ -188,7 +195,7 @@ public:
             /* I was tempted to set it FINALHACK, but Sj supports fragment, lets see */
             upgradeChainFlag(pkt);
 
-            pktVector.push_back(pkt);
+            injectPacket(pkt);
 
             pLH.completeLog("%d/%d chunk seq|%x sjPacketId %d size %d", 
                             (pkts + 1), pkts_n, ntohl(pkt->tcp->seq), pkt->SjPacketId, resizeAndCopy);
@@ -196,6 +203,7 @@ public:
 
         cache.add(origpkt);
 
+        subscribeFlow = true;
         removeOrigPkt = true;
     }
 
@@ -0,0 +1,404 @@
+/*
+ *   SniffJoke is a software able to confuse the Internet traffic analysis,
+ *   developed with the aim to improve digital privacy in communications and
+ *   to show and test some securiy weakness in traffic analysis software.
+ *   
+ *   Copyright (C) 2010, 2011 vecna <vecna@delirandom.net>
+ *                            evilaliv3 <giovanni.pellerano@evilaliv3.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Checksum.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SJ_CHECKSUM_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define SJ_CHECKSUM_NEON
+#include <arm_neon.h>
+#if !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+static const char *kernel_name = "scalar";
+
+uint32_t (*checksum_halfsum)(const unsigned char *, uint16_t) = checksum_halfsum_scalar;
+uint32_t (*checksum_copy_halfsum)(unsigned char *, const unsigned char *, uint16_t) = checksum_copy_halfsum_scalar;
+
+uint32_t checksum_halfsum_scalar(const unsigned char *data, uint16_t len)
+{
+    const uint16_t *usdata = (const uint16_t *) data;
+    const uint16_t *end = (const uint16_t *) data + (len / sizeof (uint16_t));
+    uint32_t sum = 0;
+
+    while (usdata != end)
+        sum += *usdata++;
+
+    if (len % 2)
+        sum += *(const uint8_t *) usdata;
+
+    return sum;
+}
+
+uint32_t checksum_copy_halfsum_scalar(unsigned char *dst, const unsigned char *src, uint16_t len)
+{
+    /* the words are copied with memcpy: src and dst can have a different alignment */
+    uint32_t sum = 0;
+    uint16_t word;
+    uint16_t i = 0;
+
+    for (; i + 1 < len; i += sizeof (uint16_t))
+    {
+        memcpy(&word, src + i, sizeof (uint16_t));
+        memcpy(dst + i, &word, sizeof (uint16_t));
+        sum += word;
+    }
+
+    if (len % 2)
+    {
+        dst[i] = src[i];
+        sum += src[i];
+    }
+
+    return sum;
+}
+
+#ifdef SJ_CHECKSUM_X86
+
+/*
+ * the words are summed by pmaddwd, that multiplies the signed words by 1
+ * and adds them pair by pair in 32 bit lanes: every word is biased by
+ * -0x8000 (a xor of its top bit) to be read as signed, and the bias is
+ * added back to the total. with a 64K maximum length no lane can overflow,
+ * and the total is the same 32 bit sum of the scalar code. four
+ * accumulators hide the latency of pmaddwd; the tail shorter than a
+ * vector is left to the scalar code, that handles the odd byte too.
+ */
+#define CHECKSUM_SSE2_MINLEN    64      /* shorter, the scalar code is faster */
+#define CHECKSUM_AVX2_MINLEN    128
+
+__attribute__((target("sse2")))
+static inline __m128i wordsum_sse2(__m128i v)
+{
+    return _mm_madd_epi16(_mm_xor_si128(v, _mm_set1_epi16((short) 0x8000)), _mm_set1_epi16(1));
+}
+
+__attribute__((target("sse2")))
+static inline uint32_t lanesum_sse2(__m128i acc, uint32_t words)
+{
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    return (uint32_t) _mm_cvtsi128_si32(acc) + words * 0x8000;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i wordsum_avx2(__m256i v)
+{
+    return _mm256_madd_epi16(_mm256_xor_si256(v, _mm256_set1_epi16((short) 0x8000)), _mm256_set1_epi16(1));
+}
+
+/* the 256 bit lanes are added in a 128 bit vector, where a last 16 bytes
+ * block is summed: calling the sse2 kernel with the upper halves of the
+ * registers still in use would pay the AVX-SSE transition */
+__attribute__((target("avx2")))
+static inline __m128i halves_avx2(__m256i acc)
+{
+    return _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+}
+
+__attribute__((target("sse2")))
+static uint32_t checksum_halfsum_sse2(const unsigned char *data, uint16_t len)
+{
+    if (len < CHECKSUM_SSE2_MINLEN)
+        return checksum_halfsum_scalar(data, len);
+
+    __m128i acc0 = _mm_setzero_si128();
+    __m128i acc1 = _mm_setzero_si128();
+    __m128i acc2 = _mm_setzero_si128();
+    __m128i acc3 = _mm_setzero_si128();
+    uint32_t i = 0;
+
+    for (; i + 64 <= len; i += 64)
+    {
+        acc0 = _mm_add_epi32(acc0, wordsum_sse2(_mm_loadu_si128((const __m128i *) (data + i))));
+        acc1 = _mm_add_epi32(acc1, wordsum_sse2(_mm_loadu_si128((const __m128i *) (data + i + 16))));
+        acc2 = _mm_add_epi32(acc2, wordsum_sse2(_mm_loadu_si128((const __m128i *) (data + i + 32))));
+        acc3 = _mm_add_epi32(acc3, wordsum_sse2(_mm_loadu_si128((const __m128i *) (data + i + 48))));
+    }
+
+    for (; i + 16 <= len; i += 16)
+        acc0 = _mm_add_epi32(acc0, wordsum_sse2(_mm_loadu_si128((const __m128i *) (data + i))));
+
+    acc0 = _mm_add_epi32(_mm_add_epi32(acc0, acc1), _mm_add_epi32(acc2, acc3));
+
+    return lanesum_sse2(acc0, i / 2) + checksum_halfsum_scalar(data + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static uint32_t checksum_halfsum_avx2(const unsigned char *data, uint16_t len)
+{
+    if (len < CHECKSUM_AVX2_MINLEN)
+        return checksum_halfsum_sse2(data, len);
+
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    __m256i acc2 = _mm256_setzero_si256();
+    __m256i acc3 = _mm256_setzero_si256();
+    uint32_t i = 0;
+
+    for (; i + 128 <= len; i += 128)
+    {
+        acc0 = _mm256_add_epi32(acc0, wordsum_avx2(_mm256_loadu_si256((const __m256i *) (data + i))));
+        acc1 = _mm256_add_epi32(acc1, wordsum_avx2(_mm256_loadu_si256((const __m256i *) (data + i + 32))));
+        acc2 = _mm256_add_epi32(acc2, wordsum_avx2(_mm256_loadu_si256((const __m256i *) (data + i + 64))));
+        acc3 = _mm256_add_epi32(acc3, wordsum_avx2(_mm256_loadu_si256((const __m256i *) (data + i + 96))));
+    }
+
+    for (; i + 32 <= len; i += 32)
+        acc0 = _mm256_add_epi32(acc0, wordsum_avx2(_mm256_loadu_si256((const __m256i *) (data + i))));
+
+    __m128i acc = halves_avx2(_mm256_add_epi32(_mm256_add_epi32(acc0, acc1), _mm256_add_epi32(acc2, acc3)));
+
+    if (i + 16 <= len)
+    {
+        acc = _mm_add_epi32(acc, wordsum_sse2(_mm_loadu_si128((const __m128i *) (data + i))));
+        i += 16;
+    }
+
+    return lanesum_sse2(acc, i / 2) + checksum_halfsum_scalar(data + i, len - i);
+}
+
+/* the copy is never faster in the scalar code: a single vector is enough */
+__attribute__((target("sse2")))
+static uint32_t checksum_copy_halfsum_sse2(unsigned char *dst, const unsigned char *src, uint16_t len)
+{
+    if (len < 16)
+        return checksum_copy_halfsum_scalar(dst, src, len);
+
+    __m128i acc0 = _mm_setzero_si128();
+    __m128i acc1 = _mm_setzero_si128();
+    __m128i acc2 = _mm_setzero_si128();
+    __m128i acc3 = _mm_setzero_si128();
+    uint32_t i = 0;
+
+    for (; i + 64 <= len; i += 64)
+    {
+        const __m128i v0 = _mm_loadu_si128((const __m128i *) (src + i));
+        const __m128i v1 = _mm_loadu_si128((const __m128i *) (src + i + 16));
+        const __m128i v2 = _mm_loadu_si128((const __m128i *) (src + i + 32));
+        const __m128i v3 = _mm_loadu_si128((const __m128i *) (src + i + 48));
+        _mm_storeu_si128((__m128i *) (dst + i), v0);
+        _mm_storeu_si128((__m128i *) (dst + i + 16), v1);
+        _mm_storeu_si128((__m128i *) (dst + i + 32), v2);
+        _mm_storeu_si128((__m128i *) (dst + i + 48), v3);
+        acc0 = _mm_add_epi32(acc0, wordsum_sse2(v0));
+        acc1 = _mm_add_epi32(acc1, wordsum_sse2(v1));
+        acc2 = _mm_add_epi32(acc2, wordsum_sse2(v2));
+        acc3 = _mm_add_epi32(acc3, wordsum_sse2(v3));
+    }
+
+    for (; i + 16 <= len; i += 16)
+    {
+        const __m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+        _mm_storeu_si128((__m128i *) (dst + i), v);
+        acc0 = _mm_add_epi32(acc0, wordsum_sse2(v));
+    }
+
+    acc0 = _mm_add_epi32(_mm_add_epi32(acc0, acc1), _mm_add_epi32(acc2, acc3));
+
+    return lanesum_sse2(acc0, i / 2) + checksum_copy_halfsum_scalar(dst + i, src + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static uint32_t checksum_copy_halfsum_avx2(unsigned char *dst, const unsigned char *src, uint16_t len)
+{
+    if (len < 64)
+        return checksum_copy_halfsum_sse2(dst, src, len);
+
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    __m256i acc2 = _mm256_setzero_si256();
+    __m256i acc3 = _mm256_setzero_si256();
+    uint32_t i = 0;
+
+    for (; i + 128 <= len; i += 128)
+    {
+        const __m256i v0 = _mm256_loadu_si256((const __m256i *) (src + i));
+        const __m256i v1 = _mm256_loadu_si256((const __m256i *) (src + i + 32));
+        const __m256i v2 = _mm256_loadu_si256((const __m256i *) (src + i + 64));
+        const __m256i v3 = _mm256_loadu_si256((const __m256i *) (src + i + 96));
+        _mm256_storeu_si256((__m256i *) (dst + i), v0);
+        _mm256_storeu_si256((__m256i *) (dst + i + 32), v1);
+        _mm256_storeu_si256((__m256i *) (dst + i + 64), v2);
+        _mm256_storeu_si256((__m256i *) (dst + i + 96), v3);
+        acc0 = _mm256_add_epi32(acc0, wordsum_avx2(v0));
+        acc1 = _mm256_add_epi32(acc1, wordsum_avx2(v1));
+        acc2 = _mm256_add_epi32(acc2, wordsum_avx2(v2));
+        acc3 = _mm256_add_epi32(acc3, wordsum_avx2(v3));
+    }
+
+    for (; i + 32 <= len; i += 32)
+    {
+        const __m256i v = _mm256_loadu_si256((const __m256i *) (src + i));
+        _mm256_storeu_si256((__m256i *) (dst + i), v);
+        acc0 = _mm256_add_epi32(acc0, wordsum_avx2(v));
+    }
+
+    __m128i acc = halves_avx2(_mm256_add_epi32(_mm256_add_epi32(acc0, acc1), _mm256_add_epi32(acc2, acc3)));
+
+    if (i + 16 <= len)
+    {
+        const __m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+        _mm_storeu_si128((__m128i *) (dst + i), v);
+        acc = _mm_add_epi32(acc, wordsum_sse2(v));
+        i += 16;
+    }
+
+    return lanesum_sse2(acc, i / 2) + checksum_copy_halfsum_scalar(dst + i, src + i, len - i);
+}
+
+#endif /* SJ_CHECKSUM_X86 */
+
+#ifdef SJ_CHECKSUM_NEON
+
+/* pairwise add and accumulate long: two words in every 32 bit lane, that
+ * can't overflow, so the lanes give the same 32 bit sum of the scalar code */
+static inline uint32_t lanesum_neon(uint32x4_t acc)
+{
+    return vgetq_lane_u32(acc, 0) + vgetq_lane_u32(acc, 1) + vgetq_lane_u32(acc, 2) + vgetq_lane_u32(acc, 3);
+}
+
+static uint32_t checksum_halfsum_neon(const unsigned char *data, uint16_t len)
+{
+    if (len < 32)
+        return checksum_halfsum_scalar(data, len);
+
+    uint32x4_t acc0 = vdupq_n_u32(0);
+    uint32x4_t acc1 = vdupq_n_u32(0);
+    uint32_t i = 0;
+
+    for (; i + 32 <= len; i += 32)
+    {
+        acc0 = vpadalq_u16(acc0, vld1q_u16((const uint16_t *) (data + i)));
+        acc1 = vpadalq_u16(acc1, vld1q_u16((const uint16_t *) (data + i + 16)));
+    }
+
+    for (; i + 16 <= len; i += 16)
+        acc0 = vpadalq_u16(acc0, vld1q_u16((const uint16_t *) (data + i)));
+
+    return lanesum_neon(vaddq_u32(acc0, acc1)) + checksum_halfsum_scalar(data + i, len - i);
+}
+
+static uint32_t checksum_copy_halfsum_neon(unsigned char *dst, const unsigned char *src, uint16_t len)
+{
+    if (len < 16)
+        return checksum_copy_halfsum_scalar(dst, src, len);
+
+    uint32x4_t acc0 = vdupq_n_u32(0);
+    uint32x4_t acc1 = vdupq_n_u32(0);
+    uint32_t i = 0;
+
+    for (; i + 32 <= len; i += 32)
+    {
+        const uint8x16_t v0 = vld1q_u8(src + i);
+        const uint8x16_t v1 = vld1q_u8(src + i + 16);
+        vst1q_u8(dst + i, v0);
+        vst1q_u8(dst + i + 16, v1);
+        acc0 = vpadalq_u16(acc0, vreinterpretq_u16_u8(v0));
+        acc1 = vpadalq_u16(acc1, vreinterpretq_u16_u8(v1));
+    }
+
+    for (; i + 16 <= len; i += 16)
+    {
+        const uint8x16_t v = vld1q_u8(src + i);
+        vst1q_u8(dst + i, v);
+        acc0 = vpadalq_u16(acc0, vreinterpretq_u16_u8(v));
+    }
+
+    return lanesum_neon(vaddq_u32(acc0, acc1)) + checksum_copy_halfsum_scalar(dst + i, src + i, len - i);
+}
+
+#endif /* SJ_CHECKSUM_NEON */
+
+/* the table is filled once, from the slowest kernel, with the ones usable on this CPU */
+static struct checksumKernel kernels[5];
+
+const struct checksumKernel *checksum_kernels(void)
+{
+    if (kernels[0].name != NULL)
+        return kernels;
+
+    uint8_t n = 0;
+
+    kernels[n].name = "scalar";
+    kernels[n].halfsum = checksum_halfsum_scalar;
+    kernels[n++].copy_halfsum = checksum_copy_halfsum_scalar;
+
+#ifdef SJ_CHECKSUM_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("sse2"))
+    {
+        kernels[n].name = "sse2";
+        kernels[n].halfsum = checksum_halfsum_sse2;
+        kernels[n++].copy_halfsum = checksum_copy_halfsum_sse2;
+    }
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        kernels[n].name = "avx2";
+        kernels[n].halfsum = checksum_halfsum_avx2;
+        kernels[n++].copy_halfsum = checksum_copy_halfsum_avx2;
+    }
+#endif
+
+#ifdef SJ_CHECKSUM_NEON
+#if !defined(__aarch64__)
+    if (getauxval(AT_HWCAP) & HWCAP_NEON)
+#endif
+    {
+        kernels[n].name = "neon";
+        kernels[n].halfsum = checksum_halfsum_neon;
+        kernels[n++].copy_halfsum = checksum_copy_halfsum_neon;
+    }
+#endif
+
+    return kernels;
+}
+
+void init_checksum(void)
+{
+    const struct checksumKernel *k = checksum_kernels();
+
+    while (k[1].name != NULL)
+        ++k;
+
+    checksum_halfsum = k->halfsum;
+    checksum_copy_halfsum = k->copy_halfsum;
+    kernel_name = k->name;
+}
+
+const char *checksum_kernel_name(void)
+{
+    return kernel_name;
+}
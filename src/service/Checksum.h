@@ -0,0 +1,59 @@
+/*
+ *   SniffJoke is a software able to confuse the Internet traffic analysis,
+ *   developed with the aim to improve digital privacy in communications and
+ *   to show and test some securiy weakness in traffic analysis software.
+ *   
+ *   Copyright (C) 2010, 2011 vecna <vecna@delirandom.net>
+ *                            evilaliv3 <giovanni.pellerano@evilaliv3.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SJ_CHECKSUM_H
+#define SJ_CHECKSUM_H
+
+#include <stdint.h>
+
+/*
+ * the one's complement sum used by Packet::computeHalfSum has a scalar
+ * implementation and, where the CPU supports them, SSE2/AVX2/NEON kernels.
+ * the kernel is selected once by init_checksum(), with cpuid/hwcap.
+ *
+ * every kernel returns the same 32 bit sum of the scalar code, for every
+ * length and alignment (see ChecksumTest.cc): the kernel in use never
+ * changes a checksum, nor a sum kept in a Packet snapshot.
+ */
+void init_checksum(void);
+const char *checksum_kernel_name(void);
+
+struct checksumKernel
+{
+    const char *name;
+    uint32_t (*halfsum)(const unsigned char *, uint16_t);
+    uint32_t (*copy_halfsum)(unsigned char *, const unsigned char *, uint16_t);
+};
+
+/* the kernels usable on this CPU, from the slowest, terminated by a NULL name:
+ * init_checksum() selects the last one, ChecksumBench.cc measures all of them */
+const struct checksumKernel *checksum_kernels(void);
+
+extern uint32_t (*checksum_halfsum)(const unsigned char *, uint16_t);
+
+/* memcpy(dst, src, len) returning the sum of src, computed in the same pass */
+extern uint32_t (*checksum_copy_halfsum)(unsigned char *, const unsigned char *, uint16_t);
+
+uint32_t checksum_halfsum_scalar(const unsigned char *, uint16_t);
+uint32_t checksum_copy_halfsum_scalar(unsigned char *, const unsigned char *, uint16_t);
+
+#endif /* SJ_CHECKSUM_H */
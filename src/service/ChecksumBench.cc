@@ -0,0 +1,139 @@
+/*
+ *   SniffJoke is a software able to confuse the Internet traffic analysis,
+ *   developed with the aim to improve digital privacy in communications and
+ *   to show and test some securiy weakness in traffic analysis software.
+ *   
+ *   Copyright (C) 2010, 2011 vecna <vecna@delirandom.net>
+ *                            evilaliv3 <giovanni.pellerano@evilaliv3.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * checksum_bench: a standalone microbenchmark of the checksum kernels, not
+ * installed. for every kernel usable on this CPU and for packets from 40
+ * to 9000 bytes it prints the nanoseconds for packet of the sum and of the
+ * copy with sum, and checks that every kernel gives the same sum of the
+ * scalar one (checksum_test checks every length and alignment).
+ */
+
+#include "Checksum.h"
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+/* the bytes summed for every measure: the iterations are derived from the size */
+#define BENCH_BYTES     (256 * 1024 * 1024)
+#define BENCH_MAXLEN    9000
+
+static const uint16_t bench_sizes[] = {40, 64, 128, 256, 576, 1500, 4096, 9000};
+
+static unsigned char src[BENCH_MAXLEN + 1];
+static unsigned char dst[BENCH_MAXLEN + 1];
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double bench_halfsum(const struct checksumKernel &k, uint16_t len, uint32_t *sink)
+{
+    const uint32_t iterations = BENCH_BYTES / len;
+    uint32_t acc = 0;
+
+    const double start = now_ns();
+    for (uint32_t i = 0; i < iterations; ++i)
+        acc += k.halfsum(src, len);
+    const double elapsed = now_ns() - start;
+
+    *sink += acc;
+    return elapsed / iterations;
+}
+
+static double bench_copy_halfsum(const struct checksumKernel &k, uint16_t len, uint32_t *sink)
+{
+    const uint32_t iterations = BENCH_BYTES / len;
+    uint32_t acc = 0;
+
+    const double start = now_ns();
+    for (uint32_t i = 0; i < iterations; ++i)
+        acc += k.copy_halfsum(dst, src, len);
+    const double elapsed = now_ns() - start;
+
+    *sink += acc;
+    return elapsed / iterations;
+}
+
+int main(void)
+{
+    uint32_t seed = 0x5A17C0DE;
+    for (uint32_t i = 0; i < sizeof (src); ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        src[i] = seed >> 24;
+    }
+
+    const struct checksumKernel * const kernels = checksum_kernels();
+    const uint8_t sizes = sizeof (bench_sizes) / sizeof (bench_sizes[0]);
+    uint32_t sink = 0;
+    int ret = 0;
+
+    for (uint8_t s = 0; s < sizes; ++s)
+    {
+        const uint16_t len = bench_sizes[s];
+
+        for (const struct checksumKernel *k = &kernels[1]; k->name != NULL; ++k)
+        {
+            if (k->halfsum(src, len) != kernels[0].halfsum(src, len) ||
+                    k->copy_halfsum(dst, src, len) != kernels[0].halfsum(src, len) ||
+                    memcmp(dst, src, len))
+            {
+                printf("%s: wrong checksum for %u bytes\n", k->name, len);
+                ret = 1;
+            }
+        }
+    }
+
+    printf("%-8s %6s %12s %12s %8s %8s\n", "kernel", "bytes", "sum ns/pkt", "copy ns/pkt", "sum x", "copy x");
+
+    for (uint8_t s = 0; s < sizes; ++s)
+    {
+        const uint16_t len = bench_sizes[s];
+        double scalar_sum = 0, scalar_copy = 0;
+
+        for (const struct checksumKernel *k = kernels; k->name != NULL; ++k)
+        {
+            const double sum_ns = bench_halfsum(*k, len, &sink);
+            const double copy_ns = bench_copy_halfsum(*k, len, &sink);
+
+            if (k == kernels)
+            {
+                scalar_sum = sum_ns;
+                scalar_copy = copy_ns;
+            }
+
+            printf("%-8s %6u %12.1f %12.1f %8.2f %8.2f\n", k->name, len, sum_ns, copy_ns,
+                   scalar_sum / sum_ns, scalar_copy / copy_ns);
+        }
+    }
+
+    /* the sums are printed only to keep them computed */
+    printf("(%08x)\n", sink);
+
+    return ret;
+}
@@ -0,0 +1,271 @@
+/*
+ *   SniffJoke is a software able to confuse the Internet traffic analysis,
+ *   developed with the aim to improve digital privacy in communications and
+ *   to show and test some securiy weakness in traffic analysis software.
+ *
+ *   Copyright (C) 2010, 2011 vecna <vecna@delirandom.net>
+ *                            evilaliv3 <giovanni.pellerano@evilaliv3.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * checksum_test: the checksums written by Packet::fixSum() after a change
+ * of the headers or of the payload, computed incrementally from the
+ * snapshot of the previous fixSum(), must be the same of the ones of a
+ * fresh copy of the packet, without a snapshot and summed in full.
+ * every checksum kernel of the CPU must return the same sum of the scalar
+ * one, at every length and alignment of a packet.
+ *
+ * usage: checksum_test <conf directory of the source tree>
+ */
+
+#include "Packet.h"
+#include "UserConf.h"
+#include "Checksum.h"
+
+extern auto_ptr<UserConf> userconf;
+
+/* SniffJoke.cc refers the signal handler of main.cc */
+void sigtrap(int signal)
+{
+}
+
+static uint32_t failures;
+
+static Packet *buildPacket(uint8_t ipproto, uint16_t payloadlen)
+{
+    const uint16_t l4hdrlen = (ipproto == IPPROTO_TCP) ? sizeof (struct tcphdr) : sizeof (struct udphdr);
+    const uint16_t pktlen = sizeof (struct iphdr) + l4hdrlen + payloadlen;
+
+    vector<unsigned char> buf(pktlen, 0);
+
+    struct iphdr * const ip = (struct iphdr *) &buf[0];
+    ip->version = 4;
+    ip->ihl = sizeof (struct iphdr) / 4;
+    ip->tot_len = htons(pktlen);
+    ip->id = htons(0x1234);
+    ip->ttl = 64;
+    ip->protocol = ipproto;
+    ip->saddr = htonl(0x0A000001);
+    ip->daddr = htonl(0x0A000002);
+
+    if (ipproto == IPPROTO_TCP)
+    {
+        struct tcphdr * const tcp = (struct tcphdr *) &buf[sizeof (struct iphdr)];
+        tcp->source = htons(40000);
+        tcp->dest = htons(8080);
+        tcp->seq = htonl(0x11223344);
+        tcp->ack_seq = htonl(0x55667788);
+        tcp->doff = sizeof (struct tcphdr) / 4;
+        tcp->ack = 1;
+        tcp->window = htons(8192);
+    }
+    else
+    {
+        struct udphdr * const udp = (struct udphdr *) &buf[sizeof (struct iphdr)];
+        udp->source = htons(40000);
+        udp->dest = htons(53);
+        udp->len = htons(l4hdrlen + payloadlen);
+    }
+
+    for (uint16_t i = 0; i < payloadlen; ++i)
+        buf[sizeof (struct iphdr) + l4hdrlen + i] = i * 7 + 1;
+
+    Packet * const pkt = new Packet(&buf[0], pktlen);
+    pkt->fixSum();
+
+    return pkt;
+}
+
+/* the sums of pkt, updated by fixSum(), are compared with a full computation */
+static void check(Packet &pkt, const char *what)
+{
+    pkt.fixSum();
+
+    Packet full(&pkt.pbuf[0], pkt.pbuf.size());
+    full.fixSum();
+
+    const uint16_t got = (pkt.proto == TCP) ? pkt.tcp->check : pkt.udp->check;
+    const uint16_t expected = (full.proto == TCP) ? full.tcp->check : full.udp->check;
+
+    if (got != expected || pkt.ip->check != full.ip->check)
+    {
+        printf("%s: %s checksum 0x%04x, full 0x%04x; ip checksum 0x%04x, full 0x%04x\n",
+               (pkt.proto == TCP) ? "tcp" : "udp", what, ntohs(got), ntohs(expected),
+               ntohs(pkt.ip->check), ntohs(full.ip->check));
+        ++failures;
+    }
+}
+
+static void testTCP(uint16_t payloadlen)
+{
+    Packet * const pkt = buildPacket(IPPROTO_TCP, payloadlen);
+
+    pkt->ip->ttl = 3;
+    check(*pkt, "ttl");
+
+    pkt->ip->id = htons(0xbeef);
+    check(*pkt, "id");
+
+    pkt->tcp->seq = htonl(ntohl(pkt->tcp->seq) + 1000);
+    check(*pkt, "seq");
+
+    pkt->tcp->window = 0;
+    check(*pkt, "window");
+
+    pkt->tcp->ack = 0;
+    pkt->tcp->ack_seq = 0;
+    pkt->tcp->psh = 1;
+    check(*pkt, "flags and ack_seq");
+
+    pkt->ip->daddr = htonl(0xC0A80101);
+    check(*pkt, "daddr");
+
+    pkt->corruptSum();
+    pkt->tcp->seq = htonl(ntohl(pkt->tcp->seq) - 1);
+    check(*pkt, "seq after corruptSum");
+
+    pkt->tcppayloadRandomFill();
+    check(*pkt, "payload random fill");
+
+    pkt->tcppayloadResize(payloadlen / 2 + 1);
+    pkt->tcppayloadRandomFill();
+    check(*pkt, "payload resize");
+
+    unsigned char data[100];
+    for (uint8_t i = 0; i < sizeof (data); ++i)
+        data[i] = 0xff - i;
+
+    pkt->payloadCopy(data, sizeof (data) - 1);
+    check(*pkt, "payload copy");
+
+    pkt->tcp->window = htons(1);
+    check(*pkt, "window after payload copy");
+
+    delete pkt;
+}
+
+static void testUDP(uint16_t payloadlen)
+{
+    Packet * const pkt = buildPacket(IPPROTO_UDP, payloadlen);
+
+    pkt->ip->ttl = 3;
+    check(*pkt, "ttl");
+
+    pkt->ip->id = htons(0xbeef);
+    check(*pkt, "id");
+
+    pkt->udp->source = htons(1024);
+    check(*pkt, "port");
+
+    pkt->udppayloadRandomFill();
+    check(*pkt, "payload random fill");
+
+    unsigned char data[64];
+    for (uint8_t i = 0; i < sizeof (data); ++i)
+        data[i] = i;
+
+    pkt->payloadCopy(data, sizeof (data));
+    check(*pkt, "payload copy");
+
+    pkt->ip->saddr = htonl(0xC0A80102);
+    check(*pkt, "saddr after payload copy");
+
+    delete pkt;
+}
+
+/* the 32 bit sums of the kernels must be equal, not only their checksums */
+static void testKernels(void)
+{
+    const struct checksumKernel * const kernels = checksum_kernels();
+
+    /* the worst case of the lane sums is a buffer of 0xFF */
+    static unsigned char src[IP_MAXPACKET + 16];
+    static unsigned char dst[IP_MAXPACKET + 16];
+
+    for (uint8_t fill = 0; fill < 2; ++fill)
+    {
+        for (uint32_t i = 0; i < sizeof (src); ++i)
+            src[i] = fill ? 0xff : random();
+
+        for (uint8_t off = 0; off < 16; off += 3)
+        {
+            for (uint32_t len = 0; len <= IP_MAXPACKET; len += (len < 2048) ? 1 : 4093)
+            {
+                const uint32_t expected = checksum_halfsum_scalar(&src[off], len);
+
+                for (const struct checksumKernel *k = kernels; k->name != NULL; ++k)
+                {
+                    memset(dst, 0x00, sizeof (dst));
+
+                    const uint32_t sum = k->halfsum(&src[off], len);
+                    const uint32_t copysum = k->copy_halfsum(&dst[off ^ 1], &src[off], len);
+
+                    if (sum != expected || copysum != expected || memcmp(&dst[off ^ 1], &src[off], len))
+                    {
+                        printf("%s: len %u offset %u sum 0x%08x copy 0x%08x, scalar 0x%08x\n",
+                               k->name, len, off, sum, copysum, expected);
+                        ++failures;
+                    }
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s <conf directory>\n", argv[0]);
+        return 1;
+    }
+
+    struct sj_cmdline_opts useropt;
+    memset(&useropt, 0x00, sizeof (useropt));
+    snprintf(useropt.basedir, sizeof (useropt.basedir), "%s/", argv[1]);
+    snprintf(useropt.location, sizeof (useropt.location), "generic");
+
+    try
+    {
+        userconf = auto_ptr<UserConf > (new UserConf(useropt));
+
+        /* the resizes are bound by the MTU, detected by NetIO when running */
+        userconf->runcfg.net_iface_mtu = 1500;
+
+        init_random(0);
+        init_checksum();
+
+        testKernels();
+
+        /* odd and even payloads, empty included */
+        const uint16_t lens[] = {0, 1, 100, 101, 1400};
+
+        for (uint8_t i = 0; i < sizeof (lens) / sizeof (lens[0]); ++i)
+        {
+            testTCP(lens[i]);
+            testUDP(lens[i]);
+        }
+    }
+    catch (runtime_error &exception)
+    {
+        fprintf(stderr, "%s\n", exception.what());
+        return 1;
+    }
+
+    printf("%u checksum mismatches\n", failures);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,326 @@
+/*
+ *   SniffJoke is a software able to confuse the Internet traffic analysis,
+ *   developed with the aim to improve digital privacy in communications and
+ *   to show and test some securiy weakness in traffic analysis software.
+ *   
+ *   Copyright (C) 2010, 2011 vecna <vecna@delirandom.net>
+ *                            evilaliv3 <giovanni.pellerano@evilaliv3.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * inject_hack_test: TCPTrack::injectHack() in the steady state must not
+ * allocate. operator new is counted, a plugin linked here injects packets
+ * taken from a free list (the packets of the real plugins are allocated
+ * by them, not by the core), and the same packet of a tracked flow is
+ * hacked many times, with and without the injection budget. at last the
+ * plugin creates more packets than Plugin::pktVector holds: the ones over
+ * must be dropped, not injected.
+ *
+ * usage: inject_hack_test <conf directory of the source tree>
+ */
+
+#include "TCPTrack.h"
+#include "UserConf.h"
+#include "SessionTrack.h"
+#include "TTLFocus.h"
+#include "PluginPool.h"
+#include "Checksum.h"
+
+#include <new>
+
+extern auto_ptr<UserConf> userconf;
+extern auto_ptr<PluginPool> plugin_pool;
+
+#define WARMUP_ROUNDS   16
+#define TEST_ROUNDS     4096
+#define INJECTED_PKTS   2
+
+static bool counting;
+static uint32_t allocations;
+
+/* not inlined: gcc would pair the malloc() and the free() inside them as mismatched */
+__attribute__((noinline))
+void *operator new(size_t size) throw (std::bad_alloc)
+{
+    if (counting)
+        ++allocations;
+
+    void *p = malloc(size ? size : 1);
+    if (p == NULL)
+        throw std::bad_alloc();
+
+    return p;
+}
+
+void *operator new[](size_t size) throw (std::bad_alloc)
+{
+    return operator new(size);
+}
+
+__attribute__((noinline))
+void operator delete(void *p) throw ()
+{
+    free(p);
+}
+
+void operator delete[](void *p) throw ()
+{
+    operator delete(p);
+}
+
+/* SniffJoke.cc refers the signal handler of main.cc */
+void sigtrap(int signal)
+{
+}
+
+class recycle_hack : public Plugin
+{
+public:
+    vector<Packet *> spare;
+    uint8_t inject_num;
+
+    recycle_hack() :
+    Plugin("recycle_hack", AGG_ALWAYS),
+    inject_num(INJECTED_PKTS)
+    {
+        acceptedProtos = PKTCLASS_TCP;
+        incomingProtos = 0;
+    }
+
+    virtual bool init(uint8_t configuredScramble, char *pluginOption, struct sjEnviron *sjE)
+    {
+        supportedScrambles = SCRAMBLE_INNOCENT;
+        return true;
+    }
+
+    virtual void apply(const Packet &origpkt, uint8_t availableScrambles)
+    {
+        for (uint8_t i = 0; i < inject_num && !spare.empty(); ++i)
+        {
+            Packet * const pkt = spare.back();
+            spare.pop_back();
+
+            pkt->source = PLUGIN;
+            pkt->position = (i % 2) ? POSTICIPATION : ANTICIPATION;
+            pkt->wtf = INNOCENT;
+            pkt->choosableScramble = (availableScrambles & supportedScrambles);
+            pkt->chainflag = FINALHACK;
+
+            injectPacket(pkt);
+        }
+    }
+};
+
+class InjectHackTest
+{
+private:
+    TCPTrack &ct;
+    recycle_hack &hack;
+    Packet &origpkt;
+
+public:
+    InjectHackTest(TCPTrack &ct, recycle_hack &hack, Packet &origpkt) :
+    ct(ct),
+    hack(hack),
+    origpkt(origpkt)
+    {
+        ct.p_queue.insert(origpkt, YOUNG);
+    }
+
+    ~InjectHackTest(void)
+    {
+        ct.p_queue.extract(origpkt);
+    }
+
+    /* the injected packets are taken back from the queue and returned to the plugin */
+    void round(void)
+    {
+        if (ct.injectHack(origpkt))
+            RUNTIME_EXCEPTION("the original packet is not expected to be removed");
+
+        Packet *injected[PLUGIN_PKTVECTOR_SIZE];
+        uint8_t num = 0;
+
+        Packet *pkt;
+        ct.p_queue.select(YOUNG);
+        while ((pkt = ct.p_queue.get()) != NULL)
+        {
+            if (pkt != &origpkt && num < PLUGIN_PKTVECTOR_SIZE)
+                injected[num++] = pkt;
+        }
+
+        for (uint8_t i = 0; i < num; ++i)
+        {
+            ct.p_queue.extract(*injected[i]);
+            hack.spare.push_back(injected[i]);
+        }
+    }
+
+    uint32_t run(const char *name)
+    {
+        for (uint32_t i = 0; i < WARMUP_ROUNDS; ++i)
+            round();
+
+        const uint32_t injected = origpkt.sessiontrack->injected_pktnumber;
+
+        allocations = 0;
+        counting = true;
+        for (uint32_t i = 0; i < TEST_ROUNDS; ++i)
+            round();
+        counting = false;
+
+        printf("%s: %u rounds, %u packets injected, %u allocations\n", name, TEST_ROUNDS,
+               origpkt.sessiontrack->injected_pktnumber - injected, allocations);
+
+        if (origpkt.sessiontrack->injected_pktnumber == injected)
+            RUNTIME_EXCEPTION("%s: no packet has been injected", name);
+
+        return allocations;
+    }
+
+    /* the plugin creates 4 packets more than the capacity of pktVector */
+    bool overflow(void)
+    {
+        const uint32_t injected = origpkt.sessiontrack->injected_pktnumber;
+        const size_t spares = hack.spare.size();
+
+        hack.inject_num = PLUGIN_PKTVECTOR_SIZE + 4;
+        round();
+        hack.inject_num = INJECTED_PKTS;
+
+        const uint32_t num = origpkt.sessiontrack->injected_pktnumber - injected;
+        const uint32_t dropped = spares - hack.spare.size();
+
+        printf("overflow: %u packets created, %u injected, %u dropped\n",
+               PLUGIN_PKTVECTOR_SIZE + 4, num, dropped);
+
+        return (num == PLUGIN_PKTVECTOR_SIZE && dropped == 4);
+    }
+};
+
+static Packet *buildTCPPacket(void)
+{
+    unsigned char buf[sizeof (struct iphdr) + sizeof (struct tcphdr) + 100];
+    memset(buf, 0, sizeof (buf));
+
+    struct iphdr * const ip = (struct iphdr *) buf;
+    ip->version = 4;
+    ip->ihl = sizeof (struct iphdr) / 4;
+    ip->tot_len = htons(sizeof (buf));
+    ip->ttl = 64;
+    ip->protocol = IPPROTO_TCP;
+    ip->saddr = htonl(0x0A000001);
+    ip->daddr = htonl(0x0A000002);
+
+    struct tcphdr * const tcp = (struct tcphdr *) (buf + sizeof (struct iphdr));
+    tcp->source = htons(40000);
+    tcp->dest = htons(8080);
+    tcp->seq = htonl(1);
+    tcp->ack_seq = htonl(1);
+    tcp->doff = sizeof (struct tcphdr) / 4;
+    tcp->ack = 1;
+    tcp->window = htons(8192);
+
+    return new Packet(buf, sizeof (buf));
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s <conf directory>\n", argv[0]);
+        return 1;
+    }
+
+    struct sj_cmdline_opts useropt;
+    memset(&useropt, 0x00, sizeof (useropt));
+    snprintf(useropt.basedir, sizeof (useropt.basedir), "%s/", argv[1]);
+    snprintf(useropt.location, sizeof (useropt.location), "generic");
+    useropt.max_ttl_probe = DEFAULT_MAX_TTLPROBE;
+    useropt.queue_limit = DEFAULT_QUEUE_LIMIT;
+    useropt.queue_limit_kb = DEFAULT_QUEUE_LIMIT_KB;
+
+    int ret = 0;
+
+    try
+    {
+        sj_clock = time(NULL);
+        sj_clock_us = (uint64_t) sj_clock * 1000000;
+
+        userconf = auto_ptr<UserConf > (new UserConf(useropt));
+
+        init_random(0);
+        init_checksum();
+
+        recycle_hack hack;
+        plugin_pool = auto_ptr<PluginPool > (new PluginPool(&hack, SCRAMBLE_INNOCENT));
+
+        struct sjEnviron env;
+        memset(&env, 0x00, sizeof (env));
+        plugin_pool->initializeAll(&env);
+
+        TCPTrack *ct = new TCPTrack;
+
+        Packet *origpkt = buildTCPPacket();
+        origpkt->source = TUNNEL;
+
+        SessionTrack *sessiontrack = new SessionTrack(*origpkt);
+        TTLFocus *ttlfocus = new TTLFocus(*origpkt);
+        origpkt->attachFlow(sessiontrack, ttlfocus);
+
+        for (uint32_t i = 0; i < (WARMUP_ROUNDS + TEST_ROUNDS) * INJECTED_PKTS; ++i)
+            hack.spare.push_back(new Packet(*origpkt));
+
+        {
+            InjectHackTest test(*ct, hack, *origpkt);
+
+            if (test.run("no budget"))
+                ret = 1;
+
+            /* the global bucket is refilled by the clock: one second fills it */
+            userconf->runcfg.budget_percent = 100;
+            userconf->runcfg.budget_kbps = 65535;
+            sj_clock_us += 1000000;
+
+            if (test.run("budget"))
+                ret = 1;
+
+            userconf->runcfg.budget_percent = 0;
+            userconf->runcfg.budget_kbps = 0;
+
+            if (!test.overflow())
+                ret = 1;
+        }
+
+        delete origpkt;
+
+        for (vector<Packet *>::iterator it = hack.spare.begin(); it != hack.spare.end(); ++it)
+            delete *it;
+
+        delete ct;
+        delete ttlfocus;
+        delete sessiontrack;
+
+        plugin_pool.reset();
+    }
+    catch (runtime_error &exception)
+    {
+        fprintf(stderr, "%s\n", exception.what());
+        return 1;
+    }
+
+    return ret;
+}
@@ -146,6 +146,22 @@ void NetIO::setupTUN()
     close(tmpfd);
 }
 
+void NetIO::setupRecvBatch()
+{
+    const uint16_t mtu = userconf->runcfg.net_iface_mtu;
+
+    recv_buf.resize(PKTBATCH_SIZE * mtu);
+
+    memset(recv_msgs, 0, sizeof (recv_msgs));
+    for (uint8_t i = 0; i < PKTBATCH_SIZE; ++i)
+    {
+        recv_iov[i].iov_base = &(recv_buf[i * mtu]);
+        recv_iov[i].iov_len = mtu;
+        recv_msgs[i].msg_hdr.msg_iov = &recv_iov[i];
+        recv_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
 NetIO::NetIO(void)
 {
     LOG_DEBUG("");
@@ -164,6 +180,7 @@ NetIO::NetIO(void)
 
     setupNET();
     setupTUN();
+    setupRecvBatch();
 
     fds[0].fd = tunfd;
     fds[1].fd = netfd;
@@ -230,9 +247,13 @@ void NetIO::networkIO(void)
      * if there is no data to send out the poll timeout is always
      * set to 1 ms;
      *
+     * in both the cases the timeout is shortened to the time of the
+     * next paced packet, released by analyzePacketQueue() on exit;
+     *
      * with a max cycle count of 10 and a poll timeout of 1ms
      * we will exit if:
-     *    - a burst of 20 pkts (10 network + 10 tunnel) has been received;
+     *    - a burst of 10 tunnel pkts and 10 network reads has been received
+     *      (every network read takes up to PKTBATCH_SIZE pkts);
      *    - a delay of 10ms has passed.
      *
      * read, read, read and than re-read all comments hundred times
@@ -252,36 +273,73 @@ void NetIO::networkIO(void)
     {
         if (max_cycle != 0) max_cycle--;
 
+        /*
+         * in run-to-completion mode the packets read in this burst are
+         * already in SEND, and are written without waiting the next call
+         */
+        if (max_cycle != 0 && userconf->runcfg.run_to_completion)
+        {
+            if (pkt_tun == NULL)
+                pkt_tun = conntrack->readpacket(TUNNEL);
+
+            if (pkt_net == NULL)
+                pkt_net = conntrack->readpacket(NETWORK);
+        }
+
+        /* with the SEND queue over the watermark the local stack has to wait */
+        const short tun_in = conntrack->tunnelBackpressure() ? 0 : POLLIN;
+
+        /* microseconds to the next paced packet, -1 if none */
+        const int64_t paced_us = conntrack->pacingDelayUs();
+
+        timespec timeout;
+
         if (pkt_tun != NULL || pkt_net != NULL)
         {
             /*
              * if there is some data to flush out the poll
-             * timeout is set to infinite
+             * timeout is set to infinite, or to the next paced packet
              */
 
-            fds[0].events = (pkt_net != NULL) ? POLLIN | POLLOUT : POLLIN;
+            fds[0].events = (pkt_net != NULL) ? tun_in | POLLOUT : tun_in;
             fds[1].events = (pkt_tun != NULL) ? POLLIN | POLLOUT : POLLIN;
 
-            nfds = poll(fds, 2, -1);
+            if (paced_us < 0)
+            {
+                nfds = poll(fds, 2, -1);
+            }
+            else
+            {
+                timeout.tv_sec = paced_us / 1000000;
+                timeout.tv_nsec = (paced_us % 1000000) * 1000;
+                nfds = ppoll(fds, 2, &timeout, NULL);
+            }
         }
         else
         {
             /*
              * if there are not data to flush out the poll
-             * timeout is set to 1ms
+             * timeout is set to 1ms, or to the next paced packet
              */
 
-            fds[0].events = POLLIN;
+            fds[0].events = tun_in;
             fds[1].events = POLLIN;
 
-            timespec timeout;
             timeout.tv_sec = 0;
-            timeout.tv_nsec = 1000000;
+            timeout.tv_nsec = ((paced_us >= 0 && paced_us < 1000) ? paced_us : 1000) * 1000;
             nfds = ppoll(fds, 2, &timeout, NULL);
         }
 
         if (!nfds)
+        {
+            /* a paced packet is due: analyzePacketQueue() has to release it */
+            if (paced_us >= 0 && conntrack->pacingDelayUs() == 0)
+                break;
+
+            /* nothing happened in 1ms: the idle time is used to refill the random pool */
+            random_pool_refill();
             continue;
+        }
 
         /* in the three cases poll/ppoll is set, now we check the nfds return value */
         if (nfds == -1)
@@ -311,12 +369,20 @@ void NetIO::networkIO(void)
 
         if (fds[1].revents & POLLIN) /* it's possible to read from netfd */
         {
-            ret = recv(netfd, &(pktbuf[0]), userconf->runcfg.net_iface_mtu, 0);
+            /* all the packets already queued in the socket are read with a single syscall */
+            ret = recvmmsg(netfd, recv_msgs, PKTBATCH_SIZE, MSG_DONTWAIT, NULL);
 
             if (ret == -1)
-                RUNTIME_EXCEPTION("error reading from network: %s", strerror(errno));
+            {
+                /* the call does not block: nothing to read, or interrupted, is not an error */
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    RUNTIME_EXCEPTION("error reading from network: %s", strerror(errno));
+
+                ret = 0;
+            }
 
-            conntrack->writepacket(NETWORK, &(pktbuf[0]), ret);
+            for (int i = 0; i < ret; ++i)
+                conntrack->writepacket(NETWORK, (const unsigned char *) recv_iov[i].iov_base, recv_msgs[i].msg_len);
         }
 
         if (fds[1].revents & POLLOUT) /* it's possibile to write in netfd */
@@ -27,6 +27,7 @@
 #include "TCPTrack.h"
 
 #include <poll.h>
+#include <sys/socket.h>
 #include <netpacket/packet.h>
 
 class NetIO
@@ -51,8 +52,14 @@ private:
 
     int size;
 
+    /* buffers for the recvmmsg() on netfd, PKTBATCH_SIZE packets of net_iface_mtu */
+    vector<unsigned char> recv_buf;
+    struct iovec recv_iov[PKTBATCH_SIZE];
+    struct mmsghdr recv_msgs[PKTBATCH_SIZE];
+
     void setupTUN();
     void setupNET();
+    void setupRecvBatch();
 
 public:
 
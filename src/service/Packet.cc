@@ -28,17 +28,29 @@
 #endif
 
 #include "Packet.h"
+#include "Checksum.h"
 #include "HDRoptions.h"
 #include "UserConf.h"
+#include "SessionTrack.h"
+#include "TTLFocus.h"
+
+#include <cstddef>
 
 extern auto_ptr<UserConf> userconf;
 
 uint32_t Packet::SjPacketIdCounter;
+uint32_t Packet::rejectedCounter[PKTCHECK_REASONS];
 
 Packet::Packet(const unsigned char* buff, uint16_t size) :
 prev(NULL),
 next(NULL),
+sprev(NULL),
+snext(NULL),
 queue(QUEUEUNASSIGNED),
+slot(QUEUEUNASSIGNED),
+slot_source(SOURCEUNASSIGNED),
+slot_bytes(0),
+send_not_before(0),
 SjPacketId(++SjPacketIdCounter),
 source(SOURCEUNASSIGNED),
 proto(PROTOUNASSIGNED),
@@ -48,16 +60,31 @@ choosableScramble(0),
 chainflag(HACKUNASSIGNED),
 fragment(false),
 fragFakeMTU(0),
+keep_timestamp(0),
+send_gap_us(0),
+flowHash(0),
+sessiontrack(NULL),
+ttlfocus(NULL),
 pbuf(size)
 {
+    l4snap.valid = l4snap.payloadValid = false;
+
     memcpy(&(pbuf[0]), buff, size);
     updatePacketMetadata(0, 0);
+    computeFlowHash();
 }
 
 Packet::Packet(const Packet& pkt) :
 prev(NULL),
 next(NULL),
+sprev(NULL),
+snext(NULL),
 queue(QUEUEUNASSIGNED),
+slot(QUEUEUNASSIGNED),
+slot_source(SOURCEUNASSIGNED),
+slot_bytes(0),
+send_not_before(0),
+l4snap(pkt.l4snap),
 SjPacketId(++SjPacketIdCounter),
 source(SOURCEUNASSIGNED),
 proto(PROTOUNASSIGNED),
@@ -67,16 +94,28 @@ choosableScramble(0),
 chainflag(pkt.chainflag),
 fragment(false),
 fragFakeMTU(0),
+keep_timestamp(0),
+send_gap_us(0),
+flowHash(pkt.flowHash),
+sessiontrack(NULL),
+ttlfocus(NULL),
 pbuf(pkt.pbuf)
 {
     updatePacketMetadata(0, 0);
+    attachFlow(pkt.sessiontrack, pkt.ttlfocus);
     this->SELFLOG("newly generated packet from: sjI#%d", pkt.SjPacketId);
 }
 
 Packet::Packet(const Packet& pkt, uint16_t ipdataoff, uint16_t fragdatalen, uint16_t fakeMTU) :
 prev(NULL),
 next(NULL),
+sprev(NULL),
+snext(NULL),
 queue(QUEUEUNASSIGNED),
+slot(QUEUEUNASSIGNED),
+slot_source(SOURCEUNASSIGNED),
+slot_bytes(0),
+send_not_before(0),
 SjPacketId(++SjPacketIdCounter),
 source(SOURCEUNASSIGNED),
 proto(PROTOUNASSIGNED),
@@ -86,26 +125,36 @@ choosableScramble(0),
 chainflag(pkt.chainflag),
 fragment(true),
 fragFakeMTU(fakeMTU),
+keep_timestamp(0),
+send_gap_us(0),
+flowHash(pkt.flowHash),
+sessiontrack(NULL),
+ttlfocus(NULL),
 pbuf(fragdatalen + sizeof(struct iphdr))
 {
-    /* copy of the IP header */
-    memcpy(&(pbuf[0]), &(pkt.pbuf[0]), sizeof(struct iphdr));
-
-    /* and of the selected IP payload */
-    memcpy(&(pbuf[sizeof(struct iphdr)]), &(pkt.pbuf[pkt.iphdrlen + ipdataoff]), fragdatalen);
-
     if ( (fragdatalen + sizeof(struct iphdr)) > fakeMTU )
     {
         RUNTIME_EXCEPTION("creation of a fragment of (%d + %d ) with fake MTU of %d", 
                           fragdatalen, sizeof(struct iphdr), fakeMTU);
     }
 
+    l4snap.valid = l4snap.payloadValid = false;
+
+    /* copy of the IP header */
+    memcpy(&(pbuf[0]), &(pkt.pbuf[0]), sizeof(struct iphdr));
+
+    /* and of the selected IP payload */
+    memcpy(&(pbuf[sizeof(struct iphdr)]), &(pkt.pbuf[pkt.iphdrlen + ipdataoff]), fragdatalen);
+
     /* 
      * now the packet has only the iphdr, without option and the ip payload, 
      * 12 bytes options are assured between pbuf.size() and fakeMTU, if required a resize
      */
     updatePacketMetadata(sizeof(struct iphdr), fragdatalen);
 
+    /* the last step: a constructor throwing before it leaves no reference */
+    attachFlow(pkt.sessiontrack, pkt.ttlfocus);
+
     this->SELFLOG("newly generated fragment (dataoff %d fraglen %d fakeMTU %d) source: sjI#%d", 
                 ipdataoff, fragdatalen, fakeMTU, pkt.SjPacketId);
 }
@@ -124,9 +173,84 @@ uint32_t Packet::freespace(void)
     return maxMTU() - pbuf.size();
 }
 
+pktcheck_t Packet::validate(const unsigned char *buff, int nbyte)
+{
+    if (nbyte < (int) sizeof (struct iphdr))
+        return PKTCHECK_IPHDR_SHORT;
+
+    /* checked before the narrowing: a longer read would wrap around */
+    if (nbyte > IP_MAXPACKET)
+        return PKTCHECK_OVERSIZE;
+
+    const uint16_t pktlen = nbyte;
+
+    const struct iphdr * const hdr = (const struct iphdr *) buff;
+    const uint16_t hdrlen = hdr->ihl * 4;
+
+    if (hdrlen < sizeof (struct iphdr) || pktlen < hdrlen)
+        return PKTCHECK_IPHDRLEN;
+
+    const unsigned char * const l4 = buff + hdrlen;
+    const uint16_t l4len = pktlen - hdrlen;
+
+    switch (hdr->protocol)
+    {
+    case IPPROTO_TCP:
+    {
+        if (l4len < sizeof (struct tcphdr))
+            return PKTCHECK_TCPHDR_SHORT;
+
+        const uint16_t l4hdrlen = ((const struct tcphdr *) l4)->doff * 4;
+
+        if (l4len < l4hdrlen)
+            return PKTCHECK_TCPHDR_SHORT;
+
+        if (l4hdrlen < sizeof (struct tcphdr) || l4hdrlen > sizeof (struct tcphdr) + MAXTCPOPTIONS)
+            return PKTCHECK_TCPHDRLEN;
+
+        break;
+    }
+    case IPPROTO_UDP:
+        if (l4len < sizeof (struct udphdr))
+            return PKTCHECK_UDPHDR_SHORT;
+
+        if (l4len < ntohs(((const struct udphdr *) l4)->len))
+            return PKTCHECK_UDPLEN;
+
+        break;
+    case IPPROTO_ICMP:
+        if (l4len < sizeof (struct icmphdr))
+            return PKTCHECK_ICMPHDR_SHORT;
+
+        break;
+    }
+
+    return PKTCHECK_OK;
+}
+
 /* the arguments are usually (0, 0): except in fragment creation: in this case,
  * the iphdr is stripped of the options and thus became iphdr, and tot_len is
  * resized by the construct in memcpy, therfore the new value is forced here */
+/*
+ * the addresses and the ports are combined with XOR, so the packets of the
+ * two directions of a session (keyed like SessionTrackKey) share the hash
+ */
+void Packet::computeFlowHash(void)
+{
+    uint32_t h = ip->saddr ^ ip->daddr;
+
+    if (proto == TCP)
+        h ^= (uint32_t) (tcp->source ^ tcp->dest) << 16;
+    else if (proto == UDP)
+        h ^= (uint32_t) (udp->source ^ udp->dest) << 16;
+
+    h ^= h >> 16;
+    h *= 0x45d9f3b;
+    h ^= h >> 16;
+
+    flowHash = h;
+}
+
 void Packet::updatePacketMetadata(uint16_t forceHDRsize, uint16_t forceTOTsize)
 {
     const uint16_t pktlen = pbuf.size();
@@ -252,19 +376,10 @@ void Packet::updatePacketMetadata(uint16_t forceHDRsize, uint16_t forceTOTsize)
     }
 }
 
+/* the kernel (scalar or vectorized) is selected at startup, see Checksum.cc */
 uint32_t Packet::computeHalfSum(const unsigned char* data, uint16_t len)
 {
-    const uint16_t *usdata = (uint16_t *) data;
-    const uint16_t *end = (uint16_t *) data + (len / sizeof (uint16_t));
-    uint32_t sum = 0;
-
-    while (usdata != end)
-        sum += *usdata++;
-
-    if (len % 2)
-        sum += *(uint8_t *) usdata;
-
-    return sum;
+    return checksum_halfsum(data, len);
 }
 
 uint16_t Packet::computeSum(uint32_t sum)
@@ -284,30 +399,115 @@ void Packet::fixIPSum(void)
     ip->check = computeSum(sum);
 }
 
-void Packet::fixIPTCPSum(void)
+/*
+ * RFC 1624, eqn. 3: HC' = ~(~HC + ~m + m') for every 16 bit word m changed in m'.
+ * the checksum field is skipped, its old value is the snapshot sum. returns false
+ * when the segment is not comparable with the snapshot: a full sum is required.
+ *
+ * the result is bit-exact with the full computation: both fold a non zero sum
+ * in the range [1, 0xFFFF], so the one's complement zero has a single form.
+ */
+bool Packet::incrementalSum(uint8_t l4hdrlen, uint8_t checkoff, uint16_t &sum)
 {
-    fixIPSum();
+    if (!l4snap.valid || l4snap.l4len != ippayloadlen || l4snap.l4hdrlen != l4hdrlen)
+        return false;
+
+    const uint16_t *cur = (const uint16_t *) ippayload;
+    const uint16_t *old = l4snap.l4hdr;
+    uint32_t acc = (uint16_t) ~l4snap.sum;
+
+    for (uint8_t i = 0; i < l4hdrlen / sizeof (uint16_t); ++i)
+    {
+        if (i != checkoff / sizeof (uint16_t) && cur[i] != old[i])
+            acc += (uint16_t) ~old[i] + cur[i];
+    }
+
+    /* the addresses are the only pseudo header fields not bound to l4len */
+    const uint16_t *curaddr = (const uint16_t *) &ip->saddr;
+    const uint16_t *oldaddr = (const uint16_t *) &l4snap.saddr;
+    if (l4snap.saddr != ip->saddr)
+        acc += (uint16_t) ~oldaddr[0] + curaddr[0] + (uint16_t) ~oldaddr[1] + curaddr[1];
 
-    tcp->check = 0;
+    curaddr = (const uint16_t *) &ip->daddr;
+    oldaddr = (const uint16_t *) &l4snap.daddr;
+    if (l4snap.daddr != ip->daddr)
+        acc += (uint16_t) ~oldaddr[0] + curaddr[0] + (uint16_t) ~oldaddr[1] + curaddr[1];
 
-    uint32_t sum = computeHalfSum((const unsigned char *) &ip->saddr, 8);
-    sum += htons(IPPROTO_TCP + ippayloadlen);
-    sum += computeHalfSum((const unsigned char *) tcp, ippayloadlen);
+    sum = computeSum(acc);
 
-    tcp->check = computeSum(sum);
+    return true;
 }
 
-void Packet::fixIPUDPSum(void)
+/*
+ * the checksum of a TCP/UDP segment, incremental when a snapshot is valid.
+ * a payload written bypassing the mutators (the *Resize, *RandomFill and
+ * payloadCopy methods) would leave a stale snapshot: at PACKET_LEVEL,
+ * used developing the plugins, every sum is verified with a full one.
+ */
+uint16_t Packet::transportSum(uint8_t ipproto, uint8_t l4hdrlen, uint8_t checkoff)
+{
+    uint16_t * const check = (uint16_t *) (ippayload + checkoff);
+    uint16_t sum;
+
+    if (!incrementalSum(l4hdrlen, checkoff, sum))
+    {
+        *check = 0;
+
+        if (!l4snap.payloadValid)
+        {
+            l4snap.payloadSum = computeHalfSum(ippayload + l4hdrlen, ippayloadlen - l4hdrlen);
+            l4snap.payloadValid = true;
+        }
+
+        /* the header length is even: the payload words are aligned as in the whole segment */
+        uint32_t halfsum = computeHalfSum((const unsigned char *) &ip->saddr, 8);
+        halfsum += htons(ipproto + ippayloadlen);
+        halfsum += computeHalfSum(ippayload, l4hdrlen);
+        halfsum += l4snap.payloadSum;
+
+        sum = computeSum(halfsum);
+    }
+
+    if (debug.level() == PACKET_LEVEL)
+    {
+        *check = 0;
+
+        uint32_t halfsum = computeHalfSum((const unsigned char *) &ip->saddr, 8);
+        halfsum += htons(ipproto + ippayloadlen);
+        halfsum += computeHalfSum(ippayload, ippayloadlen);
+
+        const uint16_t fullsum = computeSum(halfsum);
+
+        if (sum != fullsum)
+            RUNTIME_EXCEPTION("sjI#%u: stale checksum snapshot (0x%04x, full sum 0x%04x): payload changed bypassing the Packet mutators",
+                              SjPacketId, ntohs(sum), ntohs(fullsum));
+    }
+
+    l4snap.valid = (l4hdrlen <= SUMSNAPSHOT_HDRLEN);
+    l4snap.sum = sum;
+    l4snap.l4len = ippayloadlen;
+    l4snap.l4hdrlen = l4hdrlen;
+    l4snap.saddr = ip->saddr;
+    l4snap.daddr = ip->daddr;
+    if (l4snap.valid)
+        memcpy(l4snap.l4hdr, ippayload, l4hdrlen);
+
+    return sum;
+}
+
+/* the IP header is always summed in full: it's not larger than the snapshot to compare */
+void Packet::fixIPTCPSum(void)
 {
     fixIPSum();
 
-    udp->check = 0;
+    tcp->check = transportSum(IPPROTO_TCP, tcphdrlen, offsetof(struct tcphdr, check));
+}
 
-    uint32_t sum = computeHalfSum((const unsigned char *) &ip->saddr, 8);
-    sum += htons(IPPROTO_UDP + ippayloadlen);
-    sum += computeHalfSum((const unsigned char *) udp, ippayloadlen);
+void Packet::fixIPUDPSum(void)
+{
+    fixIPSum();
 
-    udp->check = computeSum(sum);
+    udp->check = transportSum(IPPROTO_UDP, udphdrlen, offsetof(struct udphdr, check));
 }
 
 void Packet::fixSum(void)
@@ -354,6 +554,11 @@ void Packet::corruptSum(void)
     }
 }
 
+void Packet::invalidateSum(void)
+{
+    l4snap.valid = l4snap.payloadValid = false;
+}
+
 bool Packet::selfIntegrityCheck(const char *pluginName)
 {
     if (wtf == JUDGEUNASSIGNED)
@@ -394,7 +599,7 @@ errorinfo:
 
 void Packet::randomizeID(void)
 {
-    ip->id = htons(ntohs(ip->id) - 10 + (random() % 20));
+    ip->id = htons(ntohs(ip->id) - 10 + (sj_random() % 20));
 }
 
 void Packet::iphdrResize(uint8_t size)
@@ -472,6 +677,9 @@ void Packet::tcphdrResize(uint8_t size)
 
 void Packet::ippayloadResize(uint16_t size)
 {
+    /* a resize is the preface of a payload rewrite, also when the size does not change */
+    invalidateSum();
+
     if (size == ippayloadlen)
         return;
 
@@ -494,6 +702,9 @@ void Packet::ippayloadResize(uint16_t size)
 
 void Packet::tcppayloadResize(uint16_t size)
 {
+    /* a resize is the preface of a payload rewrite, also when the size does not change */
+    invalidateSum();
+
     if (size == tcppayloadlen)
         return;
 
@@ -516,6 +727,9 @@ void Packet::tcppayloadResize(uint16_t size)
 
 void Packet::udppayloadResize(uint16_t size)
 {
+    /* a resize is the preface of a payload rewrite, also when the size does not change */
+    invalidateSum();
+
     if (size == udppayloadlen)
         return;
 
@@ -541,16 +755,19 @@ void Packet::udppayloadResize(uint16_t size)
 
 void Packet::ippayloadRandomFill(void)
 {
+    invalidateSum();
     memset_random(ippayload, pbuf.size() - iphdrlen);
 }
 
 void Packet::tcppayloadRandomFill(void)
 {
+    invalidateSum();
     memset_random(tcppayload, pbuf.size() - (iphdrlen + tcphdrlen));
 }
 
 void Packet::udppayloadRandomFill(void)
 {
+    invalidateSum();
     memset_random(udppayload, pbuf.size() - (iphdrlen + udphdrlen));
 }
 
@@ -577,9 +794,30 @@ void Packet::payloadRandomFill(void)
     }
 }
 
+/* resize the TCP/UDP payload to len and fill it from src: the partial sum
+ * is computed during the copy and kept for the next fixSum() */
+uint32_t Packet::payloadCopy(const unsigned char *src, uint16_t len)
+{
+    if (fragment == true || !(proto & (TCP | UDP)))
+        RUNTIME_EXCEPTION("it's possible to call this function only on TCP and UDP packets");
+
+    if (proto == TCP)
+        tcppayloadResize(len);
+    else
+        udppayloadResize(len);
+
+    unsigned char * const dst = (proto == TCP) ? tcppayload : udppayload;
+
+    l4snap.payloadSum = len ? checksum_copy_halfsum(dst, src, len) : 0;
+    l4snap.payloadValid = true;
+
+    return l4snap.payloadSum;
+}
+
 void Packet::selflog(const char *func, const char *format, ...) const
 {
-    if (debug.level() == SUPPRESS_LEVEL)
+    /* LOG_PACKET would discard it: the formatting is skipped too */
+    if (debug.level() < PACKET_LEVEL)
         return;
 
     char loginfo[LARGEBUF] = {0};
@@ -646,8 +884,37 @@ void Packet::selflog(const char *func, const char *format, ...) const
     }
 }
 
+const char * Packet::getCheckStr(pktcheck_t check)
+{
+    switch (check)
+    {
+    case PKTCHECK_OK:
+        return "valid";
+    case PKTCHECK_IPHDR_SHORT:
+        return "shorter than an IP header";
+    case PKTCHECK_IPHDRLEN:
+        return "invalid IP header length";
+    case PKTCHECK_TCPHDR_SHORT:
+        return "truncated TCP header";
+    case PKTCHECK_TCPHDRLEN:
+        return "invalid TCP header length";
+    case PKTCHECK_UDPHDR_SHORT:
+        return "truncated UDP header";
+    case PKTCHECK_UDPLEN:
+        return "UDP length beyond the packet";
+    case PKTCHECK_ICMPHDR_SHORT:
+        return "truncated ICMP header";
+    case PKTCHECK_OVERSIZE:
+        return "longer than an IP packet";
+    default:
+        return "unknown check";
+    }
+}
+
 Packet::~Packet()
 {
+    detachFlow();
+
 #ifdef HEAVY_PACKET_DEBUG
 #define PACKETLOG_PREFIX_TCP   "TCPpktLog/"
 #define PACKETLOG_PREFIX_UDP   "UDPpktLog/"
@@ -693,6 +960,36 @@ Packet::~Packet()
 #endif
 }
 
+/*
+ * the handles are counted in the SessionTrack and TTLFocus referred:
+ * the maps don't expire an entry while a packet in the queues uses it
+ */
+void Packet::attachFlow(SessionTrack *newsessiontrack, TTLFocus *newttlfocus)
+{
+    detachFlow();
+
+    if ((sessiontrack = newsessiontrack) != NULL)
+        ++sessiontrack->refs;
+
+    if ((ttlfocus = newttlfocus) != NULL)
+        ++ttlfocus->refs;
+}
+
+void Packet::detachFlow(void)
+{
+    if (sessiontrack != NULL)
+    {
+        --sessiontrack->refs;
+        sessiontrack = NULL;
+    }
+
+    if (ttlfocus != NULL)
+    {
+        --ttlfocus->refs;
+        ttlfocus = NULL;
+    }
+}
+
 const char * Packet::getWtfStr(judge_t wtf) const
 {
     switch (wtf)
@@ -80,19 +80,78 @@ enum chaining_t
     HACKUNASSIGNED = 0, FINALHACK = 1, REHACKABLE = 2
 };
 
+/* result of the validation of a packet received from the tunnel or the network:
+ * this is not a mask but the index of Packet::rejectedCounter[] */
+enum pktcheck_t
+{
+    PKTCHECK_OK = 0, PKTCHECK_IPHDR_SHORT = 1, PKTCHECK_IPHDRLEN = 2, PKTCHECK_TCPHDR_SHORT = 3,
+    PKTCHECK_TCPHDRLEN = 4, PKTCHECK_UDPHDR_SHORT = 5, PKTCHECK_UDPLEN = 6, PKTCHECK_ICMPHDR_SHORT = 7,
+    PKTCHECK_OVERSIZE = 8, PKTCHECK_REASONS = 9
+};
+
+/* the largest transport header handled by the incremental checksum: a TCP header with 40 bytes of options */
+#define SUMSNAPSHOT_HDRLEN      60
+
+/* a transport header as it was when its checksum was computed (see Packet::transportSum):
+ * the next fixSum() can update the sum incrementally (RFC 1624) from the words that changed,
+ * instead of reading again the whole segment. Every change to the payload invalidates it.
+ * The partial sum of the payload alone survives the header changes, and it's computed also
+ * by Packet::payloadCopy while copying */
+struct sumSnapshot
+{
+    bool payloadValid;
+    uint32_t payloadSum;
+
+    bool valid;
+    uint16_t sum; /* the checksum computed, not the field: corruptSum() can alter that */
+    uint16_t l4len;
+    uint8_t l4hdrlen;
+    uint32_t saddr;
+    uint32_t daddr;
+    uint16_t l4hdr[SUMSNAPSHOT_HDRLEN / sizeof (uint16_t)];
+};
+
+class SessionTrack;
+class TTLFocus;
+
 class Packet
 {
 private:
     friend class PacketQueue;
+    friend class TimerWheel;
     static uint32_t SjPacketIdCounter;
 
     Packet *prev;
     Packet *next;
 
+    /* links in the list of the packets of the same source in the queue */
+    Packet *sprev;
+    Packet *snext;
+
     /* reflection variable used on queue change */
     queue_t queue;
 
+    /* the list of the queue containing the packet, see PacketQueue.h */
+    uint8_t slot;
+    source_t slot_source;
+
+    /* the size accounted by the queue at the insertion, pbuf may change later */
+    uint16_t slot_bytes;
+
+    /* the time of sj_clock_us assigned to the packet in the TimerWheel */
+    uint64_t send_not_before;
+
+    struct sumSnapshot l4snap;
+
+    bool incrementalSum(uint8_t, uint8_t, uint16_t &);
+    void computeFlowHash(void);
+    void detachFlow(void);
+    uint16_t transportSum(uint8_t, uint8_t, uint8_t);
+
 public:
+    /* counters of the packets dropped by validate(), one for every pktcheck_t */
+    static uint32_t rejectedCounter[PKTCHECK_REASONS];
+
     uint32_t SjPacketId;
 
     /* variable to keep track of packet creation origins */
@@ -118,6 +177,23 @@ public:
     bool fragment;
     uint16_t fragFakeMTU;
 
+    /* sj_clock_us at the insertion in KEEP, used for the hold time limit */
+    uint64_t keep_timestamp;
+
+    /* microseconds of spacing from the previous packet sent to the same
+       destination; if not 0 the packet is paced by the TimerWheel */
+    uint32_t send_gap_us;
+
+    /* hash of the flow, the same in both directions; computed on the packet
+       received and inherited by the copies and the fragments */
+    uint32_t flowHash;
+
+    /* the session and the destination of the packet, resolved once when it is
+       read from the tunnel (see attachFlow) and inherited like flowHash: the
+       entries referred are not expired by the maps, NULL when not resolved */
+    SessionTrack *sessiontrack;
+    TTLFocus *ttlfocus;
+
     struct iphdr *ip;
     uint8_t iphdrlen; /* [20 - 60] bytes */
     unsigned char *ippayload;
@@ -165,8 +241,15 @@ public:
     uint32_t maxMTU(void);
     uint32_t freespace(void);
 
+    /* the checks of updatePacketMetadata, done on a raw buffer before the
+     * allocation of a Packet and without throwing: a malformed packet from
+     * the network is a common event, not an exception */
+    static pktcheck_t validate(const unsigned char *, int);
+
     void updatePacketMetadata(uint16_t, uint16_t);
 
+    void attachFlow(SessionTrack *, TTLFocus *);
+
     /* IP/TCP checksum functions */
     uint32_t computeHalfSum(const unsigned char*, uint16_t);
     uint16_t computeSum(uint32_t);
@@ -175,6 +258,8 @@ public:
     void fixIPUDPSum(void);
     void fixSum(void);
     void corruptSum(void);
+    /* required after a direct write in the payload: the payload functions below already call it */
+    void invalidateSum(void);
 
     /* autochecking */
     bool selfIntegrityCheck(const char *);
@@ -190,6 +275,7 @@ public:
     void tcppayloadRandomFill(void);
     void udppayloadRandomFill(void);
     void payloadRandomFill(void);
+    uint32_t payloadCopy(const unsigned char *, uint16_t);
 
     /* MALFORMED hacks and distortion of INNOCENT packets */
     bool injectIPOpts(bool, bool);
@@ -200,6 +286,7 @@ public:
     const char *getWtfStr(judge_t) const;
     const char *getSourceStr(source_t) const;
     const char *getChainStr(chaining_t) const;
+    static const char *getCheckStr(pktcheck_t);
 };
 
 #endif /* SJ_PACKET_H */
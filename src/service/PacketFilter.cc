@@ -38,54 +38,43 @@ ip_daddr(pkt.ip->daddr)
 {
 }
 
-bool FilterEntry::operator<(FilterEntry comp) const
-{
-    if (ip_id < comp.ip_id)
-        return true;
-    else if (ip_id > comp.ip_id)
-        return false;
-    else
-    {
-        if (ip_totallen < comp.ip_totallen)
-            return true;
-        else if (ip_totallen > comp.ip_totallen)
-            return false;
-        else
-        {
-            if (ip_saddr < comp.ip_saddr)
-                return true;
-            else if (ip_saddr > comp.ip_saddr)
-                return false;
-            else
-            {
-                if (ip_daddr < comp.ip_daddr)
-                    return true;
-                else
-                    return false;
-            }
-        }
-    }
-}
-
 FilterMultiset::FilterMultiset(void) :
 timeout_len(PLUGINHASH_EXPIRYTIME),
 manage_timeout(sj_clock + timeout_len),
-first(&fm[0]),
-second(&fm[1])
+first(&fg[0]),
+second(&fg[1])
 {
+    memset(fg, 0, sizeof (fg));
 }
 
-FilterMultiset::~FilterMultiset(void)
+/*
+ * returns the slot of the entry, or the free slot where it has to be
+ * added; NULL only when the generation is full, that rotate() avoids.
+ */
+struct filterSlot *FilterMultiset::lookup(struct filterGeneration &gen, const FilterEntry &hash)
 {
-    first->clear();
-    second->clear();
+    uint32_t i = (hash.ip_saddr ^ hash.ip_daddr ^ ((uint32_t) hash.ip_id << 16 | hash.ip_totallen)) * 2654435761U;
+
+    for (uint32_t probe = 0; probe < PACKETFILTER_SLOTS; ++probe, ++i)
+    {
+        struct filterSlot &slot = gen.slot[i & (PACKETFILTER_SLOTS - 1)];
+
+        if (!slot.used)
+            return &slot;
+
+        if (slot.ip_id == hash.ip_id && slot.ip_totallen == hash.ip_totallen &&
+                slot.ip_saddr == hash.ip_saddr && slot.ip_daddr == hash.ip_daddr)
+            return &slot;
+    }
+
+    return NULL;
 }
 
 /*
  * tests the existance of the entry;
  * returns:
  *      - true:  if found, and automatically does remove the entry;
- *               due to the multiset entry can be duplicated, this is
+ *               due to the entry can be added more times, this is
  *               a feature much important that permit a fine count
  *               during packet filtering.
  * 
@@ -95,37 +84,66 @@ bool FilterMultiset::check(const FilterEntry &hash)
 {
     manage();
 
-    if (first->erase(hash) || second->erase(hash))
-        return true;
+    struct filterGeneration * const gens[2] = {first, second};
+
+    for (uint8_t i = 0; i < 2; ++i)
+    {
+        struct filterSlot * const slot = lookup(*gens[i], hash);
+
+        if (slot != NULL && slot->used && slot->count)
+        {
+            --slot->count;
+            return true;
+        }
+    }
 
     return false;
 }
 
 /*
- * inserts a new entry; due to the use of multiset entry can be
- * duplicate; this is particular important to permit multiple
- * packet to define multiple filters.
+ * inserts a new entry; an entry can be added more times; this is
+ * particular important to permit multiple packet to define multiple filters.
  * so repeated filters works as a fine counter during packet filtering.
  *
  */
 void FilterMultiset::add(const FilterEntry &hash)
 {
-    second->insert(hash);
+    if (second->used >= PACKETFILTER_SLOTS / 4 * 3)
+        rotate();
+
+    struct filterSlot * const slot = lookup(*second, hash);
+
+    if (!slot->used)
+    {
+        slot->ip_saddr = hash.ip_saddr;
+        slot->ip_daddr = hash.ip_daddr;
+        slot->ip_id = hash.ip_id;
+        slot->ip_totallen = hash.ip_totallen;
+        slot->used = true;
+        ++second->used;
+    }
+
+    ++slot->count;
 }
 
-void FilterMultiset::manage(void)
+void FilterMultiset::rotate(void)
 {
-    if (manage_timeout > sj_clock - timeout_len)
-        return;
-
-    multiset<FilterEntry> *tmp = first;
+    struct filterGeneration *tmp = first;
     first = second;
     second = tmp;
-    second->clear();
+    memset(second, 0, sizeof (*second));
 
     manage_timeout = sj_clock + timeout_len;
 }
 
+void FilterMultiset::manage(void)
+{
+    if (manage_timeout > sj_clock - timeout_len)
+        return;
+
+    rotate();
+}
+
 bool PacketFilter::filterICMPErrors(const Packet &pkt)
 {
     if (pkt.icmppayloadlen > sizeof (struct iphdr))
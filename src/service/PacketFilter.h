@@ -33,7 +33,28 @@ public:
 
     FilterEntry(uint16_t, uint16_t, uint32_t, uint32_t);
     FilterEntry(const Packet &);
-    bool operator<(FilterEntry) const;
+};
+
+/*
+ * two generations of a fixed hash table, the older is dropped every
+ * PLUGINHASH_EXPIRYTIME seconds or when the newer is 3/4 full: add() is
+ * called for every injected packet and never allocates. an entry can be
+ * added more times and is matched by check() as many times.
+ */
+struct filterSlot
+{
+    uint32_t ip_saddr;
+    uint32_t ip_daddr;
+    uint16_t ip_id;
+    uint16_t ip_totallen;
+    uint16_t count; /* matches left, a used slot at 0 stays until the rotation */
+    bool used;
+};
+
+struct filterGeneration
+{
+    uint32_t used;
+    struct filterSlot slot[PACKETFILTER_SLOTS];
 };
 
 class FilterMultiset
@@ -41,16 +62,18 @@ class FilterMultiset
 private:
     const uint32_t timeout_len;
     uint32_t manage_timeout;
-    multiset<FilterEntry> fm[2];
-    multiset<FilterEntry> *first;
-    multiset<FilterEntry> *second;
+    struct filterGeneration fg[2];
+    struct filterGeneration *first;
+    struct filterGeneration *second;
+
+    static struct filterSlot *lookup(struct filterGeneration &, const FilterEntry &);
+    void rotate(void);
 
     /* called automagically */
     void manage(void);
 
 public:
     FilterMultiset(void);
-    ~FilterMultiset(void);
     bool check(const FilterEntry &);
     void add(const FilterEntry &);
 };
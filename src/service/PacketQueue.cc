@@ -24,14 +24,23 @@
 
 PacketQueue::PacketQueue(void) :
 pkt_count(0),
-cur_queue(FIRST_QUEUE),
+cur_slot(FIRST_QUEUE),
+cur_source(SOURCEUNASSIGNED),
 cur_pkt(NULL),
-next_pkt(NULL)
+next_pkt(NULL),
+last_pkt(NULL)
 {
     LOG_DEBUG("");
 
-    memset(front, 0, sizeof (Packet*)*(QUEUE_NUM));
-    memset(back, 0, sizeof (Packet*)*(QUEUE_NUM));
+    memset(front, 0, sizeof (Packet*)*(QUEUE_SLOTS));
+    memset(back, 0, sizeof (Packet*)*(QUEUE_SLOTS));
+    memset(sfront, 0, sizeof (sfront));
+    memset(sback, 0, sizeof (sback));
+    memset(drr, 0, sizeof (drr));
+    memset(queue_pkts, 0, sizeof (queue_pkts));
+    memset(queue_bytes, 0, sizeof (queue_bytes));
+    memset(slot_pkts, 0, sizeof (slot_pkts));
+    memset(dir_pkts, 0, sizeof (dir_pkts));
 }
 
 PacketQueue::~PacketQueue(void)
@@ -46,6 +55,104 @@ PacketQueue::~PacketQueue(void)
     }
 }
 
+bool PacketQueue::isControl(const Packet &pkt)
+{
+    if (pkt.source == TRACEROUTE)
+        return true;
+
+    if (pkt.proto != TCP)
+        return false;
+
+    return pkt.tcp->syn || (pkt.tcp->ack && !pkt.tcp->fin && !pkt.tcp->rst && !pkt.tcppayloadlen);
+}
+
+uint8_t PacketQueue::slotOf(const Packet &pkt, queue_t queue) const
+{
+    if (queue != SEND)
+        return queue;
+
+    const uint8_t dirslot = SEND_FIRST_SLOT + ((pkt.source == NETWORK) ? SEND_DIR_TUNNEL : SEND_DIR_NETWORK) * SEND_DIR_SLOTS;
+    const uint8_t bucket = pkt.flowHash & (SEND_DRR_BUCKETS - 1);
+
+    /* the priority never moves a packet before a packet of the same flow */
+    if (front[dirslot + bucket] == NULL && isControl(pkt))
+        return dirslot + SEND_PRIO_BUCKET;
+
+    return dirslot + bucket;
+}
+
+/* a bucket becoming not empty enters the ring of its direction */
+void PacketQueue::activateBucket(uint8_t slot)
+{
+    if (slot < SEND_FIRST_SLOT)
+        return;
+
+    struct drrState &d = drr[(slot - SEND_FIRST_SLOT) / SEND_DIR_SLOTS];
+    const uint8_t bucket = (slot - SEND_FIRST_SLOT) % SEND_DIR_SLOTS;
+
+    if (bucket == SEND_PRIO_BUCKET || d.active[bucket])
+        return;
+
+    d.active[bucket] = true;
+    d.deficit[bucket] = 0;
+    d.ring[(d.head + d.count) % SEND_DRR_BUCKETS] = bucket;
+    ++d.count;
+}
+
+void PacketQueue::account(Packet &pkt)
+{
+    pkt.slot_bytes = pkt.pbuf.size();
+
+    ++queue_pkts[pkt.queue];
+    queue_bytes[pkt.queue] += pkt.slot_bytes;
+    ++slot_pkts[pkt.slot];
+
+    if (pkt.slot >= SEND_FIRST_SLOT)
+        ++dir_pkts[(pkt.slot - SEND_FIRST_SLOT) / SEND_DIR_SLOTS];
+}
+
+void PacketQueue::unaccount(Packet &pkt)
+{
+    --queue_pkts[pkt.queue];
+    queue_bytes[pkt.queue] -= pkt.slot_bytes;
+    --slot_pkts[pkt.slot];
+
+    if (pkt.slot >= SEND_FIRST_SLOT)
+        --dir_pkts[(pkt.slot - SEND_FIRST_SLOT) / SEND_DIR_SLOTS];
+}
+
+void PacketQueue::linkSource(Packet &pkt)
+{
+    pkt.slot_source = pkt.source;
+
+    Packet *&sf = sfront[pkt.slot][pkt.slot_source];
+    Packet *&sb = sback[pkt.slot][pkt.slot_source];
+
+    pkt.snext = NULL;
+    pkt.sprev = sb;
+    if (sb == NULL)
+        sf = &pkt;
+    else
+        sb->snext = &pkt;
+    sb = &pkt;
+}
+
+void PacketQueue::unlinkSource(Packet &pkt)
+{
+    if (pkt.sprev != NULL)
+        pkt.sprev->snext = pkt.snext;
+    else
+        sfront[pkt.slot][pkt.slot_source] = pkt.snext;
+
+    if (pkt.snext != NULL)
+        pkt.snext->sprev = pkt.sprev;
+    else
+        sback[pkt.slot][pkt.slot_source] = pkt.sprev;
+
+    pkt.sprev = NULL;
+    pkt.snext = NULL;
+}
+
 void PacketQueue::insert(Packet &pkt, queue_t queue)
 {
     if (pkt.queue != QUEUEUNASSIGNED)
@@ -57,19 +164,25 @@ void PacketQueue::insert(Packet &pkt, queue_t queue)
             pkt.next == NULL;
      */
 
+    const uint8_t slot = slotOf(pkt, queue);
+
     ++pkt_count;
     pkt.queue = queue;
-    if (front[queue] == NULL)
+    pkt.slot = slot;
+    linkSource(pkt);
+    account(pkt);
+    activateBucket(pkt.slot);
+    if (front[slot] == NULL)
     {
-        front[queue] = &pkt;
-        back[queue] = &pkt;
+        front[slot] = &pkt;
+        back[slot] = &pkt;
     }
     else
     {
-        pkt.prev = back[queue];
+        pkt.prev = back[slot];
         pkt.next = NULL;
-        back[queue]->next = &pkt;
-        back[queue] = &pkt;
+        back[slot]->next = &pkt;
+        back[slot] = &pkt;
     }
 }
 
@@ -84,15 +197,26 @@ void PacketQueue::insertBefore(Packet &pkt, Packet &ref)
             pkt.next == NULL;
      */
 
+    /* a packet going in the other direction has no position relative to ref */
+    if (slotOf(pkt, ref.queue) != ref.slot)
+    {
+        insert(pkt, ref.queue);
+        return;
+    }
+
     ++pkt_count;
     pkt.queue = ref.queue;
+    pkt.slot = ref.slot;
+    linkSource(pkt);
+    account(pkt);
+    activateBucket(pkt.slot);
 
-    if (front[ref.queue] == &ref)
+    if (front[ref.slot] == &ref)
     {
         pkt.prev = NULL;
         pkt.next = &ref;
         ref.prev = &pkt;
-        front[ref.queue] = &pkt;
+        front[ref.slot] = &pkt;
         return;
     }
 
@@ -117,14 +241,25 @@ void PacketQueue::insertAfter(Packet &pkt, Packet &ref)
             pkt.next == NULL;
      */
 
+    /* a packet going in the other direction has no position relative to ref */
+    if (slotOf(pkt, ref.queue) != ref.slot)
+    {
+        insert(pkt, ref.queue);
+        return;
+    }
+
     ++pkt_count;
     pkt.queue = ref.queue;
+    pkt.slot = ref.slot;
+    linkSource(pkt);
+    account(pkt);
+    activateBucket(pkt.slot);
 
-    if (back[ref.queue] == &ref)
+    if (back[ref.slot] == &ref)
     {
         pkt.prev = &ref;
         ref.next = &pkt;
-        back[ref.queue] = &pkt;
+        back[ref.slot] = &pkt;
         return;
     }
 
@@ -141,14 +276,17 @@ void PacketQueue::insertAfter(Packet &pkt, Packet &ref)
 void PacketQueue::extract(Packet &pkt)
 {
     --pkt_count;
-    queue_t queue = pkt.queue;
+    const uint8_t slot = pkt.slot;
+
+    unlinkSource(pkt);
+    unaccount(pkt);
 
-    if (front[queue] == &pkt)
+    if (front[slot] == &pkt)
     {
-        if (back[queue] == &pkt)
+        if (back[slot] == &pkt)
         {
-            front[queue] = NULL;
-            back[queue] = NULL;
+            front[slot] = NULL;
+            back[slot] = NULL;
         }
         else
         {
@@ -156,19 +294,19 @@ void PacketQueue::extract(Packet &pkt)
              * in this case we have always a next;
              * so we can dereference it without checking != NULL
              */
-            front[queue] = front[queue]->next;
-            front[queue]->prev = NULL;
+            front[slot] = front[slot]->next;
+            front[slot]->prev = NULL;
         }
         goto remove_reset_pkt;
     }
-    else if (back[queue] == &pkt)
+    else if (back[slot] == &pkt)
     {
         /*
          * in this case we have always a prev;
          * so we can dereference it without checking != NULL
          */
-        back[queue] = back[queue]->prev;
-        back[queue]->next = NULL;
+        back[slot] = back[slot]->prev;
+        back[slot]->next = NULL;
         goto remove_reset_pkt;
     }
 
@@ -182,6 +320,7 @@ void PacketQueue::extract(Packet &pkt)
 remove_reset_pkt:
 
     pkt.queue = QUEUEUNASSIGNED;
+    pkt.slot = QUEUEUNASSIGNED;
     pkt.prev = NULL;
     pkt.next = NULL;
 }
@@ -196,13 +335,26 @@ void PacketQueue::drop(Packet &pkt)
 
 void PacketQueue::select(queue_t queue)
 {
-    cur_queue = queue;
+    cur_slot = queue;
+    cur_source = SOURCEUNASSIGNED;
     cur_pkt = NULL;
     next_pkt = front[queue];
 }
 
+void PacketQueue::selectSource(uint8_t slot, source_t source)
+{
+    cur_slot = slot;
+    cur_source = source;
+    next_pkt = sfront[slot][source];
+    last_pkt = sback[slot][source];
+}
+
 Packet* PacketQueue::get(void)
 {
+    /* the selection of SEND walks all the lists of the two directions */
+    while (next_pkt == NULL && cur_slot >= SEND && cur_slot < QUEUE_SLOTS - 1)
+        next_pkt = front[++cur_slot];
+
     if (next_pkt != NULL)
     {
         cur_pkt = next_pkt;
@@ -214,13 +366,133 @@ Packet* PacketQueue::get(void)
 
 Packet* PacketQueue::getSource(source_t requestSrc)
 {
-    while (next_pkt != NULL)
+    /*
+     * the first call moves the cursor on the list of the source; the
+     * last packet is taken here, to not visit the packets inserted by
+     * the caller during the walk (as the plugin packets in the HACK queue)
+     */
+    if (cur_source == SOURCEUNASSIGNED)
+        selectSource(cur_slot, requestSrc);
+
+    while (next_pkt == NULL && cur_slot >= SEND && cur_slot < QUEUE_SLOTS - 1)
+        selectSource(cur_slot + 1, requestSrc);
+
+    if (next_pkt != NULL)
     {
         cur_pkt = next_pkt;
-        next_pkt = next_pkt->next;
-
-        if (cur_pkt->source == requestSrc)
-            return cur_pkt; /* FOUND */
+        next_pkt = (cur_pkt == last_pkt) ? NULL : cur_pkt->snext;
+        return cur_pkt; /* FOUND */
     }
     return NULL; /* NOT FOUND */
 }
+
+/*
+ * extracts the next packet of the SEND queue to be written in the
+ * destination requested: NETWORK returns the packets received from the
+ * network (to be written in the tunnel), TUNNEL all the others.
+ *
+ * the priority list is served first, then the flow buckets with deficit
+ * round robin: a bucket sends while its deficit covers the packet size,
+ * otherwise it receives SEND_DRR_QUANTUM bytes and goes to the ring tail.
+ */
+Packet* PacketQueue::extractSend(source_t destsource)
+{
+    const uint8_t dir = (destsource == NETWORK) ? SEND_DIR_TUNNEL : SEND_DIR_NETWORK;
+    const uint8_t dirslot = SEND_FIRST_SLOT + dir * SEND_DIR_SLOTS;
+    struct drrState &d = drr[dir];
+
+    Packet *pkt = front[dirslot + SEND_PRIO_BUCKET];
+    if (pkt != NULL)
+    {
+        extract(*pkt);
+        return pkt;
+    }
+
+    /*
+     * a bucket gets its quantum when its visit starts, and sends in the same
+     * visit while the deficit covers the packets: a new flow sends at its
+     * first visit, without waiting a round of the busy ones.
+     */
+    while (d.count)
+    {
+        const uint8_t bucket = d.ring[d.head];
+
+        pkt = front[dirslot + bucket];
+
+        /* the bucket has been emptied by extract() */
+        if (pkt == NULL)
+        {
+            d.active[bucket] = false;
+            d.head = (d.head + 1) % SEND_DRR_BUCKETS;
+            --d.count;
+            d.credited = false;
+            continue;
+        }
+
+        if (!d.credited)
+        {
+            d.deficit[bucket] += SEND_DRR_QUANTUM;
+            d.credited = true;
+        }
+
+        if (d.deficit[bucket] < pkt->pbuf.size())
+        {
+            d.ring[(d.head + d.count) % SEND_DRR_BUCKETS] = bucket;
+            d.head = (d.head + 1) % SEND_DRR_BUCKETS;
+            d.credited = false;
+            continue;
+        }
+
+        d.deficit[bucket] -= pkt->pbuf.size();
+        extract(*pkt);
+
+        if (front[dirslot + bucket] == NULL)
+        {
+            d.active[bucket] = false;
+            d.head = (d.head + 1) % SEND_DRR_BUCKETS;
+            --d.count;
+            d.credited = false;
+        }
+
+        return pkt;
+    }
+
+    return NULL;
+}
+
+/*
+ * chooses the packet to be dropped when a queue is over its limits: the
+ * last injected packet, if injectedFirst and there is one, otherwise the
+ * last packet. in SEND the longest flow list is chosen, so the flows
+ * keeping a short queue are not penalized by the bulk ones.
+ */
+Packet* PacketQueue::dropCandidate(queue_t queue, bool injectedFirst)
+{
+    uint8_t first = queue, last = queue;
+
+    if (queue == SEND)
+    {
+        first = SEND_FIRST_SLOT;
+        last = QUEUE_SLOTS - 1;
+    }
+
+    Packet *injected = NULL, *tail = NULL;
+    uint32_t injected_len = 0, tail_len = 0;
+
+    for (uint16_t slot = first; slot <= last; ++slot)
+    {
+        if (injectedFirst && sback[slot][PLUGIN] != NULL && slot_pkts[slot] > injected_len)
+        {
+            injected = sback[slot][PLUGIN];
+            injected_len = slot_pkts[slot];
+        }
+
+        if (back[slot] != NULL && slot_pkts[slot] > tail_len)
+        {
+            tail = back[slot];
+            tail_len = slot_pkts[slot];
+        }
+    }
+
+    return (injected != NULL) ? injected : tail;
+}
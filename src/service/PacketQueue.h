@@ -30,15 +30,72 @@
 #define LAST_QUEUE  (SEND)
 #define QUEUE_NUM   (LAST_QUEUE + 1)
 
+/*
+ * the SEND queue is kept in lists separated by direction (to the network,
+ * or to the tunnel for the packets received from the network) and, in every
+ * direction, by flow: Packet::flowHash selects one of SEND_DRR_BUCKETS lists,
+ * served by extractSend() with deficit round robin. the order is kept inside
+ * every flow, and that is the only order that matters for the
+ * ANTICIPATION/POSTICIPATION placement.
+ *
+ * a control packet (ttl probe, SYN, pure ACK) whose flow has nothing
+ * pending goes in the priority list of its direction, served first.
+ *
+ * the slot SEND itself is never used: the lists are after QUEUE_NUM.
+ */
+#define SEND_DIR_NETWORK    0
+#define SEND_DIR_TUNNEL     1
+#define SEND_PRIO_BUCKET    (SEND_DRR_BUCKETS)
+#define SEND_DIR_SLOTS      (SEND_DRR_BUCKETS + 1)
+#define SEND_FIRST_SLOT     (QUEUE_NUM)
+#define QUEUE_SLOTS         (SEND_FIRST_SLOT + 2 * SEND_DIR_SLOTS)
+
+/*
+ * every list is indexed a second time by source, in insertion order, so
+ * getSource() visits only the packets of the requested source. the main
+ * list keeps the global order needed by insertBefore/insertAfter.
+ */
+#define SOURCE_NUM          (TRACEROUTE + 1)
+
 class PacketQueue
 {
 private:
+
+    /* the ring of the active buckets of a direction, with their deficit */
+    struct drrState
+    {
+        uint8_t ring[SEND_DRR_BUCKETS];
+        uint8_t head;
+        uint8_t count;
+        bool credited; /* the head bucket has had its quantum in this visit */
+        bool active[SEND_DRR_BUCKETS];
+        uint32_t deficit[SEND_DRR_BUCKETS];
+    };
+
     uint32_t pkt_count;
-    Packet *front[QUEUE_NUM];
-    Packet *back[QUEUE_NUM];
-    queue_t cur_queue;
+    uint32_t queue_pkts[QUEUE_NUM];
+    uint32_t queue_bytes[QUEUE_NUM];
+    uint32_t slot_pkts[QUEUE_SLOTS];
+    uint32_t dir_pkts[2];
+    Packet *front[QUEUE_SLOTS];
+    Packet *back[QUEUE_SLOTS];
+    Packet *sfront[QUEUE_SLOTS][SOURCE_NUM];
+    Packet *sback[QUEUE_SLOTS][SOURCE_NUM];
+    uint8_t cur_slot;
+    source_t cur_source;
     Packet *cur_pkt;
     Packet *next_pkt;
+    Packet *last_pkt;
+    struct drrState drr[2];
+
+    static bool isControl(const Packet &);
+    uint8_t slotOf(const Packet &, queue_t) const;
+    void activateBucket(uint8_t);
+    void account(Packet &);
+    void unaccount(Packet &);
+    void linkSource(Packet &);
+    void unlinkSource(Packet &);
+    void selectSource(uint8_t, source_t);
 
 public:
     PacketQueue(void);
@@ -48,14 +105,37 @@ public:
     void insertAfter(Packet &, Packet &);
     void extract(Packet &);
     void drop(Packet &);
+    /*
+     * a selection is walked with get() or with getSource() for a single
+     * source; getSource() does not return the packets of the source
+     * inserted after its first call.
+     */
     void select(queue_t);
     Packet* get(void);
     Packet* getSource(source_t);
+    Packet* extractSend(source_t);
+    Packet* dropCandidate(queue_t, bool);
 
     uint32_t size(void)
     {
         return pkt_count;
     };
+
+    uint32_t packets(queue_t queue) const
+    {
+        return queue_pkts[queue];
+    };
+
+    uint32_t bytes(queue_t queue) const
+    {
+        return queue_bytes[queue];
+    };
+
+    /* packets in SEND to be written in the destination, as in extractSend() */
+    uint32_t sendPending(source_t destsource) const
+    {
+        return dir_pkts[(destsource == NETWORK) ? SEND_DIR_TUNNEL : SEND_DIR_NETWORK];
+    };
 };
 
 #endif /* SJ_PACKET_QUEUE_H */
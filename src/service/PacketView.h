@@ -0,0 +1,266 @@
+/*
+ *   SniffJoke is a software able to confuse the Internet traffic analysis,
+ *   developed with the aim to improve digital privacy in communications and
+ *   to show and test some securiy weakness in traffic analysis software.
+ *   
+ *   Copyright (C) 2010, 2011 vecna <vecna@delirandom.net>
+ *                            evilaliv3 <giovanni.pellerano@evilaliv3.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SJ_PACKETVIEW_H
+#define SJ_PACKETVIEW_H
+
+#include "Packet.h"
+
+/*
+ * A PacketView is a typed access to a Packet: the proto/fragment dispatch is
+ * done once, when the view is created, and after that the header accessors
+ * and the checksum routine are resolved at compile time, without repeating
+ * the switch(proto) in every plugin and in Packet::fixSum().
+ *
+ * The view keep only a reference to the Packet and read the metadata pointers
+ * on every access, so it remains valid after a resize of the packet.
+ *
+ * A const view (ConstTcpView & co.) is the one usable in Plugin::condition
+ * and Plugin::apply: its accessors return const pointers, taken from the
+ * const overloads of the ProtoTraits, so the original packet can't be
+ * written through it. fixSum() is declared on every view, but as a member
+ * of a template it is compiled only when called: calling it on a const
+ * view is a compile time error, as calling sport()/dport() on an IcmpView
+ * (ICMP has no ports).
+ */
+
+template <proto_t P> struct ProtoTraits;
+
+template <> struct ProtoTraits<TCP>
+{
+    typedef struct tcphdr hdr_t;
+
+    static hdr_t *hdr(Packet &pkt)
+    {
+        return pkt.tcp;
+    }
+
+    static const hdr_t *hdr(const Packet &pkt)
+    {
+        return pkt.tcp;
+    }
+
+    static uint8_t hdrlen(const Packet &pkt)
+    {
+        return pkt.tcphdrlen;
+    }
+
+    static unsigned char *payload(Packet &pkt)
+    {
+        return pkt.tcppayload;
+    }
+
+    static const unsigned char *payload(const Packet &pkt)
+    {
+        return pkt.tcppayload;
+    }
+
+    static uint16_t payloadlen(const Packet &pkt)
+    {
+        return pkt.tcppayloadlen;
+    }
+
+    static void fixSum(Packet &pkt)
+    {
+        pkt.fixIPTCPSum();
+    }
+};
+
+template <> struct ProtoTraits<UDP>
+{
+    typedef struct udphdr hdr_t;
+
+    static hdr_t *hdr(Packet &pkt)
+    {
+        return pkt.udp;
+    }
+
+    static const hdr_t *hdr(const Packet &pkt)
+    {
+        return pkt.udp;
+    }
+
+    static uint8_t hdrlen(const Packet &pkt)
+    {
+        return pkt.udphdrlen;
+    }
+
+    static unsigned char *payload(Packet &pkt)
+    {
+        return pkt.udppayload;
+    }
+
+    static const unsigned char *payload(const Packet &pkt)
+    {
+        return pkt.udppayload;
+    }
+
+    static uint16_t payloadlen(const Packet &pkt)
+    {
+        return pkt.udppayloadlen;
+    }
+
+    static void fixSum(Packet &pkt)
+    {
+        pkt.fixIPUDPSum();
+    }
+};
+
+template <> struct ProtoTraits<ICMP>
+{
+    typedef struct icmphdr hdr_t;
+
+    static hdr_t *hdr(Packet &pkt)
+    {
+        return pkt.icmp;
+    }
+
+    static const hdr_t *hdr(const Packet &pkt)
+    {
+        return pkt.icmp;
+    }
+
+    static uint8_t hdrlen(const Packet &pkt)
+    {
+        return pkt.icmphdrlen;
+    }
+
+    static unsigned char *payload(Packet &pkt)
+    {
+        return pkt.icmppayload;
+    }
+
+    static const unsigned char *payload(const Packet &pkt)
+    {
+        return pkt.icmppayload;
+    }
+
+    static uint16_t payloadlen(const Packet &pkt)
+    {
+        return pkt.icmppayloadlen;
+    }
+
+    /* the same of Packet::fixSum(): the ICMP checksum is never touched by sniffjoke */
+    static void fixSum(Packet &pkt)
+    {
+        pkt.fixIPSum();
+    }
+};
+
+/* the pointers returned by a view are const when its Packet is */
+template <typename PKT, typename T> struct ViewPtr
+{
+    typedef T *type;
+};
+
+template <typename T> struct ViewPtr<const Packet, T>
+{
+    typedef const T *type;
+};
+
+template <proto_t P, typename PKT = Packet>
+class PacketView
+{
+private:
+    typedef ProtoTraits<P> traits;
+
+    PKT &pkt;
+
+public:
+    typedef typename traits::hdr_t hdr_t;
+    typedef typename ViewPtr<PKT, struct iphdr>::type ip_ptr;
+    typedef typename ViewPtr<PKT, hdr_t>::type hdr_ptr;
+    typedef typename ViewPtr<PKT, unsigned char>::type payload_ptr;
+
+    /* the check used by the constructor, usable to test before the creation */
+    static bool match(const Packet &p)
+    {
+        return (p.fragment == false && p.proto == P);
+    }
+
+    /* a mismatch is a code bug, not a network event: a malformed packet
+     * from the network is never parsed with a proto different from its own */
+    explicit PacketView(PKT &p) :
+    pkt(p)
+    {
+        if (!match(p))
+            RUNTIME_EXCEPTION("view of proto %u requested on packet sjI#%u (proto %u fragment %u)",
+                              P, p.SjPacketId, p.proto, p.fragment);
+    }
+
+    PKT &packet(void) const
+    {
+        return pkt;
+    }
+
+    ip_ptr ip(void) const
+    {
+        return pkt.ip;
+    }
+
+    hdr_ptr hdr(void) const
+    {
+        return traits::hdr(pkt);
+    }
+
+    uint8_t hdrlen(void) const
+    {
+        return traits::hdrlen(pkt);
+    }
+
+    payload_ptr payload(void) const
+    {
+        return traits::payload(pkt);
+    }
+
+    uint16_t payloadlen(void) const
+    {
+        return traits::payloadlen(pkt);
+    }
+
+    /* host byte order, TCP and UDP only */
+    uint16_t sport(void) const
+    {
+        return ntohs(traits::hdr(pkt)->source);
+    }
+
+    uint16_t dport(void) const
+    {
+        return ntohs(traits::hdr(pkt)->dest);
+    }
+
+    /* without the switch of Packet::fixSum(); on a const view it does not compile */
+    void fixSum(void)
+    {
+        traits::fixSum(pkt);
+    }
+};
+
+typedef PacketView<TCP> TcpView;
+typedef PacketView<UDP> UdpView;
+typedef PacketView<ICMP> IcmpView;
+
+typedef PacketView<TCP, const Packet> ConstTcpView;
+typedef PacketView<UDP, const Packet> ConstUdpView;
+typedef PacketView<ICMP, const Packet> ConstIcmpView;
+
+#endif /* SJ_PACKETVIEW_H */
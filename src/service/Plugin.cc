@@ -122,7 +122,16 @@ void PluginCache::manage(void)
 Plugin::Plugin(const char* pluginName, uint16_t pluginFrequency) :
 pluginName(pluginName),
 pluginFrequency(pluginFrequency),
-removeOrigPkt(false)
+removeOrigPkt(false),
+pktVectorNum(0),
+acceptedProtos(PKTCLASS_ALL),
+acceptedFlags(PKTCLASS_ALL),
+acceptedPayloads(PKTCLASS_ALL),
+acceptedChains(PKTCLASS_ALL),
+incomingProtos(PKTCLASS_ALL),
+incomingFlags(PKTCLASS_ALL),
+incomingPort(0),
+subscribeFlow(false)
 {
 }
 
@@ -173,12 +182,48 @@ void Plugin::apply(const Packet &, uint8_t availableScrambles)
 
 void Plugin::mangleIncoming(Packet &pkt)
 {
+    /* not implemented by the plugin: no more incoming packets */
+    incomingProtos = 0;
+}
+
+/*
+ * the core calls this once for every batch of incoming packets; the
+ * default calls mangleIncoming() on every packet, and reports the
+ * removal requests in remove[]. a plugin could override it to walk its
+ * own structures once for the whole batch.
+ */
+void Plugin::mangleIncomingBatch(Packet * const *pkts, uint8_t count, bool *remove)
+{
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        mangleIncoming(*pkts[i]);
+
+        if (removeOrigPkt)
+        {
+            remove[i] = true;
+            removeOrigPkt = false;
+        }
+    }
 }
 
 void Plugin::reset(void)
 {
     removeOrigPkt = false;
-    pktVector.clear();
+    pktVectorNum = 0;
+}
+
+/* the packet is given to the core: over PLUGIN_PKTVECTOR_SIZE it's deleted */
+void Plugin::injectPacket(Packet *pkt)
+{
+    if (pktVectorNum == PLUGIN_PKTVECTOR_SIZE)
+    {
+        LOG_ALL("%s: more than %u packets created in a single hack, sjI#%u dropped",
+                pluginName, PLUGIN_PKTVECTOR_SIZE, pkt->SjPacketId);
+        delete pkt;
+        return;
+    }
+
+    pktVector[pktVectorNum++] = pkt;
 }
 
 void Plugin::upgradeChainFlag(Packet *pkt)
@@ -25,6 +25,7 @@
 
 #include "Utils.h"
 #include "Packet.h"
+#include "PacketView.h"
 
 /* 
  *
@@ -33,6 +34,11 @@
  * HackPacket classes are implemented as external modules and the programmer
  * shoulds implement condition and apply, constructor and distructor methods.
  *
+ * The injection budget is checked before apply() (see TCPTrack::affordBudget),
+ * and the output of an apply() is never discarded by the core for the budget:
+ * a plugin could keep its state (cache records, subscribeFlow) in apply()
+ * only because of this, a refused hack must not leave any state behind.
+ *
  * At the end of every plugin code, it's is required to export two "C" symbols,
  * pointing to the constructor and the destructor method.
  *
@@ -82,6 +88,41 @@ public:
     void explicitDelete(struct cacheRecord *);
 };
 
+/* the packets a plugin can create in one apply() or mangleIncoming(): the
+ * ones over are dropped by injectPacket() (the largest hack today makes 5) */
+#define PLUGIN_PKTVECTOR_SIZE       16
+
+/*
+ * the classes of a packet used by the candidate index of PluginPool: a
+ * plugin declares in its constructor the classes its condition() could
+ * accept, and it is never proposed a packet outside them. the declaration
+ * is a fast pre-filter, condition() remains the real check; the default
+ * accepts every class.
+ */
+#define PKTCLASS_ALL            0xff
+
+#define PKTCLASS_TCP            1
+#define PKTCLASS_UDP            2
+#define PKTCLASS_FRAGMENT       4
+#define PKTCLASS_OTHER          8       /* ICMP and other IP protocols */
+#define PKTCLASS_PROTOS         4
+
+#define PKTCLASS_SYN            1       /* SYN, with or without ACK */
+#define PKTCLASS_RST            2       /* any RST */
+#define PKTCLASS_FIN            4       /* FIN without RST */
+#define PKTCLASS_ACK            8       /* ACK without SYN, RST and FIN */
+#define PKTCLASS_NOFLAGS        16      /* none of the previous, and every not TCP packet */
+#define PKTCLASS_FLAGS          5
+
+#define PKTCLASS_EMPTY          1       /* no TCP/UDP payload (IP payload for the others) */
+#define PKTCLASS_SMALL          2       /* up to PKTCLASS_SMALL_PAYLOAD bytes */
+#define PKTCLASS_LARGE          4
+#define PKTCLASS_PAYLOADS       3
+#define PKTCLASS_SMALL_PAYLOAD  200
+
+#define PKTCLASS_CHAIN(c)       (1 << (c))      /* c is a chaining_t */
+#define PKTCLASS_CHAINS         3
+
 class Plugin
 {
 public:
@@ -93,18 +134,40 @@ public:
     bool removeOrigPkt; /* boolean to be set true if the plugin
                            needs to remove the original packet */
 
-    vector<Packet *> pktVector; /* std vector of Packet* used for created packets */
+    Packet *pktVector[PLUGIN_PKTVECTOR_SIZE]; /* the created packets, added by injectPacket() */
+    uint8_t pktVectorNum;
+
+    /* PKTCLASS_* masks of the packets accepted by condition() */
+    uint8_t acceptedProtos;
+    uint8_t acceptedFlags;
+    uint8_t acceptedPayloads;
+    uint8_t acceptedChains;
+
+    /*
+     * subscription to the incoming packets, see TCPTrack::notifyIncomingBatch:
+     * mangleIncoming() receives the packets of the PKTCLASS_* incomingProtos
+     * and incomingFlags classes, coming from incomingPort if not 0, plus the
+     * packets of the flows of the outgoing packets to which apply() has
+     * set subscribeFlow. the default mangleIncoming() clears incomingProtos,
+     * so a plugin not implementing it is never called again.
+     */
+    uint8_t incomingProtos;
+    uint8_t incomingFlags;
+    uint16_t incomingPort;
+    bool subscribeFlow;
 
     Plugin(const char *, uint16_t);
 
     judge_t pktRandomDamage(uint8_t, uint8_t);
     void upgradeChainFlag(Packet *);
+    void injectPacket(Packet *);
 
     /* Plugin is an abstract class */
     virtual bool init(uint8_t, char *, struct sjEnviron *) = 0;
     virtual bool condition(const Packet &, uint8_t);
     virtual void apply(const Packet &, uint8_t);
     virtual void mangleIncoming(Packet &);
+    virtual void mangleIncomingBatch(Packet * const *, uint8_t, bool *);
     virtual void reset(void);
 
     /* follow the utilities usable by the plugins */
@@ -74,6 +74,7 @@ PluginTrack::PluginTrack(const char *plugabspath, uint8_t enabledScrambles, char
     }
 
     declaredScramble = enabledScrambles;
+    avg_cost = 0;
 
     if(plugOpt != NULL)
         declaredOpt = strdup(plugOpt);
@@ -89,6 +90,20 @@ PluginTrack::PluginTrack(const char *plugabspath, uint8_t enabledScrambles, char
             );
 }
 
+/* a plugin linked in the binary: it's not unloaded by ~PluginPool, the caller owns it */
+PluginTrack::PluginTrack(Plugin *linkedObj, uint8_t enabledScrambles) :
+pluginHandler(NULL),
+fp_CreatePluginObj(NULL),
+fp_DeletePluginObj(NULL),
+fp_versionValue(NULL),
+selfObj(linkedObj),
+declaredScramble(enabledScrambles),
+declaredOpt(NULL),
+poolIndex(0),
+avg_cost(0)
+{
+}
+
 void *PluginTrack::forcedSymbolCopy( const char *symName, const char *pap)
 {
     void *obtainPtr = dlsym(pluginHandler, symName);
@@ -124,6 +139,146 @@ void PluginPool::initializeAll(struct sjEnviron *autoptrList)
 
         counter++;
     }
+
+    buildCandidateIndex();
+    buildIncomingIndex();
+}
+
+/* the position of the bits of the PKTCLASS_* proto and flags masks, and the payload length */
+void PluginPool::classify(const Packet &pkt, uint8_t &proto, uint8_t &flags, uint16_t &payloadlen)
+{
+    if (pkt.fragment)
+    {
+        proto = 2;
+        payloadlen = pkt.ippayloadlen;
+    }
+    else if (pkt.proto == TCP)
+    {
+        proto = 0;
+        payloadlen = pkt.tcppayloadlen;
+    }
+    else if (pkt.proto == UDP)
+    {
+        proto = 1;
+        payloadlen = pkt.udppayloadlen;
+    }
+    else
+    {
+        proto = 3;
+        payloadlen = pkt.ippayloadlen;
+    }
+
+    if (proto != 0)
+        flags = 4;
+    else if (pkt.tcp->rst)
+        flags = 1;
+    else if (pkt.tcp->syn)
+        flags = 0;
+    else if (pkt.tcp->fin)
+        flags = 2;
+    else if (pkt.tcp->ack)
+        flags = 3;
+    else
+        flags = 4;
+}
+
+/*
+ * returns the index of the class of the packet, combining the position of
+ * the bits of the PKTCLASS_* masks in the order proto, flags, payload, chain
+ */
+uint8_t PluginPool::classOf(const Packet &pkt)
+{
+    uint8_t proto, flags, payload;
+    uint16_t payloadlen;
+
+    classify(pkt, proto, flags, payloadlen);
+
+    if (!payloadlen)
+        payload = 0;
+    else if (payloadlen <= PKTCLASS_SMALL_PAYLOAD)
+        payload = 1;
+    else
+        payload = 2;
+
+    return ((proto * PKTCLASS_FLAGS + flags) * PKTCLASS_PAYLOADS + payload) * PKTCLASS_CHAINS + pkt.chainflag;
+}
+
+/*
+ * the candidate plugins of every packet class are computed once, from
+ * the classes declared by the plugins: injectHack() calls condition()
+ * only on the plugins of the class of the packet.
+ */
+void PluginPool::buildCandidateIndex(void)
+{
+    memset(candidateIndex, 0, sizeof (candidateIndex));
+
+    for (uint8_t proto = 0; proto < PKTCLASS_PROTOS; ++proto)
+        for (uint8_t flags = 0; flags < PKTCLASS_FLAGS; ++flags)
+            for (uint8_t payload = 0; payload < PKTCLASS_PAYLOADS; ++payload)
+                for (uint8_t chain = 0; chain < PKTCLASS_CHAINS; ++chain)
+                {
+                    const uint8_t index = ((proto * PKTCLASS_FLAGS + flags) * PKTCLASS_PAYLOADS + payload) * PKTCLASS_CHAINS + chain;
+
+                    for (uint8_t i = 0; i < pool.size(); ++i)
+                    {
+                        const Plugin *plugin = pool[i]->selfObj;
+
+                        if ((plugin->acceptedProtos & (1 << proto)) && (plugin->acceptedFlags & (1 << flags)) &&
+                                (plugin->acceptedPayloads & (1 << payload)) && (plugin->acceptedChains & (1 << chain)))
+                            candidateIndex[index] |= ((uint64_t) 1 << i);
+                    }
+                }
+}
+
+/*
+ * rebuilt at the startup and when a plugin unsubscribes itself from the
+ * incoming packets (see Plugin::mangleIncoming)
+ */
+void PluginPool::buildIncomingIndex(void)
+{
+    memset(incomingIndex, 0, sizeof (incomingIndex));
+    memset(incomingPortIndex, 0, sizeof (incomingPortIndex));
+
+    for (uint8_t proto = 0; proto < PKTCLASS_PROTOS; ++proto)
+        for (uint8_t flags = 0; flags < PKTCLASS_FLAGS; ++flags)
+            for (uint8_t i = 0; i < pool.size(); ++i)
+            {
+                const Plugin *plugin = pool[i]->selfObj;
+
+                if (!(plugin->incomingProtos & (1 << proto)) || !(plugin->incomingFlags & (1 << flags)))
+                    continue;
+
+                if (plugin->incomingPort)
+                    incomingPortIndex[proto * PKTCLASS_FLAGS + flags] |= ((uint64_t) 1 << i);
+                else
+                    incomingIndex[proto * PKTCLASS_FLAGS + flags] |= ((uint64_t) 1 << i);
+            }
+}
+
+/* the plugins subscribed to the packet by class and port; the flow subscriptions are in SessionTrack */
+uint64_t PluginPool::incomingSubscribers(const Packet &pkt) const
+{
+    uint8_t proto, flags;
+    uint16_t payloadlen;
+
+    classify(pkt, proto, flags, payloadlen);
+
+    uint64_t subscribers = incomingIndex[proto * PKTCLASS_FLAGS + flags];
+    uint64_t ported = incomingPortIndex[proto * PKTCLASS_FLAGS + flags];
+
+    /* the port subscriptions are possible only on the not fragmented TCP and UDP */
+    if (!ported || proto > 1)
+        return subscribers;
+
+    const uint16_t sport = ntohs((proto == 0) ? pkt.tcp->source : pkt.udp->source);
+
+    for (uint8_t i = 0; ported; ++i, ported >>= 1)
+    {
+        if ((ported & 1) && pool[i]->selfObj->incomingPort == sport)
+            subscribers |= ((uint64_t) 1 << i);
+    }
+
+    return subscribers;
 }
 
 /*
@@ -155,6 +310,16 @@ globalEnabledScrambles(0)
     LOG_ALL("SniffJoke will use this configuration to create confusion also on real packets");
 }
 
+/*
+ * a pool of a single plugin linked in the binary, without reading
+ * plugins-enabled.conf and without dlopen: used by the tests.
+ */
+PluginPool::PluginPool(Plugin *linkedObj, uint8_t enabledScrambles) :
+globalEnabledScrambles(enabledScrambles)
+{
+    pool.push_back(new PluginTrack(linkedObj, enabledScrambles));
+}
+
 PluginPool::~PluginPool(void)
 {
     LOG_DEBUG("");
@@ -164,11 +329,14 @@ PluginPool::~PluginPool(void)
     {
         const PluginTrack *plugin = *it;
 
-        LOG_DEBUG("calling %s destructor and closing plugin handler", plugin->selfObj->pluginName);
+        if (plugin->pluginHandler != NULL)
+        {
+            LOG_DEBUG("calling %s destructor and closing plugin handler", plugin->selfObj->pluginName);
 
-        plugin->fp_DeletePluginObj(plugin->selfObj);
+            plugin->fp_DeletePluginObj(plugin->selfObj);
 
-        dlclose(plugin->pluginHandler);
+            dlclose(plugin->pluginHandler);
+        }
 
         if(plugin->declaredOpt != NULL)
             free(plugin->declaredOpt);
@@ -179,9 +347,13 @@ PluginPool::~PluginPool(void)
 
 void PluginPool::importPlugin(const char *plugabspath, const char *enablerEntry, uint8_t enabledScramble, char *pOpt)
 {
+    if (pool.size() == PLUGINPOOL_MAX)
+        RUNTIME_EXCEPTION("unable to load plugin %s: max %u plugins are supported", enablerEntry, PLUGINPOOL_MAX);
+
     try
     {
         PluginTrack *plugin = new PluginTrack(plugabspath, enabledScramble, pOpt);
+        plugin->poolIndex = pool.size();
         pool.push_back(plugin);
     }
     catch (runtime_error &e)
@@ -45,15 +45,36 @@ public:
     uint8_t declaredScramble;
     char *declaredOpt;
 
+    /* position in PluginPool::pool, the bit of the plugin in the bitmaps */
+    uint8_t poolIndex;
+
+    /* average bytes injected by an apply(), the cheaper plugins are tried
+       first when the injection budget is enabled */
+    uint32_t avg_cost;
+
     PluginTrack(const char *, uint8_t, char *);
+    PluginTrack(Plugin *, uint8_t);
 private:
     void *forcedSymbolCopy( const char *, const char *);
 };
 
+/* the candidates of a packet class are a bitmap indexed by position in the pool */
+#define PLUGINPOOL_MAX      64
+#define PKTCLASS_NUM        (PKTCLASS_PROTOS * PKTCLASS_FLAGS * PKTCLASS_PAYLOADS * PKTCLASS_CHAINS)
+
 class PluginPool
 {
 private:
     uint8_t globalEnabledScrambles;
+    uint64_t candidateIndex[PKTCLASS_NUM];
+
+    /* plugins subscribed to the incoming packets of a class, without and with a port */
+    uint64_t incomingIndex[PKTCLASS_PROTOS * PKTCLASS_FLAGS];
+    uint64_t incomingPortIndex[PKTCLASS_PROTOS * PKTCLASS_FLAGS];
+
+    static void classify(const Packet &, uint8_t &, uint8_t &, uint16_t &);
+    static uint8_t classOf(const Packet &);
+    void buildCandidateIndex(void);
     void importPlugin(const char *, const char *, uint8_t, char *);
     void parseOnlyPlugin(void);
     void parseEnablerFile(void);
@@ -61,10 +82,19 @@ private:
 
 public:
     PluginPool();
+    PluginPool(Plugin *, uint8_t);
     ~PluginPool(void);
     uint8_t enabledScrambles();
     void initializeAll(struct sjEnviron *);
 
+    uint64_t candidates(const Packet &pkt) const
+    {
+        return candidateIndex[classOf(pkt)];
+    };
+
+    uint64_t incomingSubscribers(const Packet &) const;
+    void buildIncomingIndex(void);
+
     vector<PluginTrack *> pool;
 };
 
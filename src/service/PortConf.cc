@@ -195,6 +195,7 @@ void portLine::extractValue(void)
         { AGG_STARTPEEK, AGG_N_STARTPEEK},
         { AGG_LONGPEEK, AGG_N_LONGPEEK},
         { AGG_HANDSHAKE, AGG_N_HANDSHAKE},
+        { AGG_BULKDECAY, AGG_N_BULKDECAY},
         { 0, NULL}
     };
 
@@ -0,0 +1,292 @@
+/*
+ *   SniffJoke is a software able to confuse the Internet traffic analysis,
+ *   developed with the aim to improve digital privacy in communications and
+ *   to show and test some securiy weakness in traffic analysis software.
+ *   
+ *   Copyright (C) 2010, 2011 vecna <vecna@delirandom.net>
+ *                            evilaliv3 <giovanni.pellerano@evilaliv3.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Utils.h"
+
+#include <fcntl.h>
+
+/* the lanes of the bulk generator, one xoshiro256++ state word for lane */
+typedef uint64_t v4u64 __attribute__ ((vector_size(4 * sizeof (uint64_t))));
+
+struct randomState
+{
+    bool seeded;
+    uint64_t s[4];
+    v4u64 v[4];
+};
+
+/*
+ * the ring of pre-generated bytes: the bytes are consumed from head and
+ * appended after head + avail, every byte is given out only once.
+ */
+struct randomPool
+{
+    unsigned char *buf;
+    uint32_t head;
+    uint32_t avail;
+    time_t last_reseed;
+};
+
+static uint64_t random_seed;
+static uint32_t random_threads;
+
+/* kept open by init_random: after the chroot /dev/urandom is not reachable */
+static int random_urandom_fd = -1;
+static bool random_pool_enabled;
+
+static __thread struct randomState rs;
+static __thread struct randomPool rp;
+
+static inline uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+/* splitmix64, the generator suggested by the xoshiro authors to expand a seed */
+static uint64_t splitmix64(uint64_t &x)
+{
+    uint64_t z = (x += UINT64_C(0x9E3779B97F4A7C15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+}
+
+static void seed_thread(void)
+{
+    uint64_t x = random_seed + __sync_fetch_and_add(&random_threads, 1) * UINT64_C(0xD1B54A32D192ED03);
+
+    for (uint8_t i = 0; i < 4; ++i)
+        rs.s[i] = splitmix64(x);
+
+    for (uint8_t i = 0; i < 4; ++i)
+    {
+        for (uint8_t l = 0; l < 4; ++l)
+            rs.v[i][l] = splitmix64(x);
+    }
+
+    rs.seeded = true;
+}
+
+void init_random(uint32_t seed)
+{
+    random_seed = seed;
+
+    /*
+     * the pool and the reseed are used only with a random seed: the refill
+     * depends on the idle time, and with them a fixed seed would not give
+     * reproducible sequences anymore.
+     */
+    random_pool_enabled = !seed;
+
+    if (!seed)
+    {
+        if (random_urandom_fd == -1)
+            random_urandom_fd = open("/dev/urandom", O_RDONLY);
+
+        if (random_urandom_fd == -1 || read(random_urandom_fd, &random_seed, sizeof (random_seed)) != sizeof (random_seed))
+            random_seed = ((uint64_t) time(NULL) << 32) ^ getpid();
+    }
+
+    /* the calling thread is reseeded with the new seed */
+    random_threads = 0;
+    seed_thread();
+}
+
+uint64_t sj_random64(void)
+{
+    if (!rs.seeded)
+        seed_thread();
+
+    uint64_t * const s = rs.s;
+    const uint64_t result = rotl(s[0] + s[3], 23) + s[0];
+    const uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+
+    return result;
+}
+
+uint32_t sj_random(void)
+{
+    return sj_random64() >> 32;
+}
+
+ptrdiff_t random_index(ptrdiff_t n)
+{
+    return sj_random() % n;
+}
+
+/* 32 bytes for every step of the four xoshiro256++ lanes */
+static void random_generate(unsigned char *cp, size_t n)
+{
+    if (!rs.seeded)
+        seed_thread();
+
+    v4u64 * const v = rs.v;
+
+    while (n)
+    {
+        /* the vectors are kept in this function: passing them by value changes the ABI */
+        const v4u64 sum = v[0] + v[3];
+        const v4u64 result = ((sum << 23) | (sum >> 41)) + v[0];
+        const v4u64 t = v[1] << 17;
+
+        v[2] ^= v[0];
+        v[3] ^= v[1];
+        v[1] ^= v[2];
+        v[0] ^= v[3];
+        v[2] ^= t;
+        v[3] = (v[3] << 45) | (v[3] >> 19);
+
+        const size_t step = (n < sizeof (result)) ? n : sizeof (result);
+        memcpy(cp, &result, step);
+        cp += step;
+        n -= step;
+    }
+}
+
+/*
+ * fresh entropy from the kernel is mixed in the states of the thread; the
+ * bytes still in the pool come from the old states and are dropped.
+ */
+static void random_reseed(void)
+{
+    uint64_t x;
+
+    rp.last_reseed = sj_clock;
+
+    if (read(random_urandom_fd, &x, sizeof (x)) != sizeof (x))
+        return;
+
+    if (!rs.seeded)
+        seed_thread();
+
+    for (uint8_t i = 0; i < 4; ++i)
+        rs.s[i] ^= splitmix64(x);
+
+    for (uint8_t i = 0; i < 4; ++i)
+    {
+        for (uint8_t l = 0; l < 4; ++l)
+            rs.v[i][l] ^= splitmix64(x);
+    }
+
+    rp.head = rp.avail = 0;
+}
+
+/* a time compare for every cycle: a busy service is never idle, but must be reseeded too */
+void random_reseed_check(void)
+{
+    if (!random_pool_enabled || random_urandom_fd == -1)
+        return;
+
+    if (!rp.last_reseed)
+        rp.last_reseed = sj_clock;
+    else if (sj_clock - rp.last_reseed >= RANDOMPOOL_RESEED_TIMER)
+        random_reseed();
+}
+
+void random_pool_refill(void)
+{
+    if (!random_pool_enabled)
+        return;
+
+    if (rp.buf == NULL)
+    {
+        rp.buf = (unsigned char *) malloc(RANDOMPOOL_SIZE);
+        if (rp.buf == NULL)
+            return;
+    }
+
+    uint32_t len = RANDOMPOOL_SIZE - rp.avail;
+    if (!len)
+        return;
+
+    if (len > RANDOMPOOL_REFILL_CHUNK)
+        len = RANDOMPOOL_REFILL_CHUNK;
+
+    /* the free space starts after the available bytes and can wrap */
+    const uint32_t tail = (rp.head + rp.avail) % RANDOMPOOL_SIZE;
+    const uint32_t first = (len < RANDOMPOOL_SIZE - tail) ? len : RANDOMPOOL_SIZE - tail;
+
+    random_generate(&rp.buf[tail], first);
+    if (len > first)
+        random_generate(&rp.buf[0], len - first);
+
+    rp.avail += len;
+}
+
+void* memset_random(void *s, size_t n)
+{
+    if (debug.level() == TESTING_LEVEL)
+    {
+        memset(s, '6', n);
+        return s;
+    }
+
+    unsigned char *cp = (unsigned char*) s;
+
+    if (n > rp.avail)
+    {
+        /* the pool is empty or too short: the bytes are generated here */
+        random_generate(cp, n);
+        return s;
+    }
+
+    const size_t first = (n < RANDOMPOOL_SIZE - rp.head) ? n : RANDOMPOOL_SIZE - rp.head;
+
+    memcpy(cp, &rp.buf[rp.head], first);
+    if (n > first)
+        memcpy(cp + first, &rp.buf[0], n - first);
+
+    rp.head = (rp.head + n) % RANDOMPOOL_SIZE;
+    rp.avail -= n;
+
+    return s;
+}
+
+/* the pool of the calling thread and the /dev/urandom descriptor are released */
+void clean_random(void)
+{
+    free(rp.buf);
+    memset(&rp, 0, sizeof (rp));
+
+    if (random_urandom_fd != -1)
+    {
+        close(random_urandom_fd);
+        random_urandom_fd = -1;
+    }
+
+    random_pool_enabled = false;
+}
+
+bool random_percent(int32_t percent)
+{
+    if (debug.level() == TESTING_LEVEL)
+        return true;
+
+    return ( (int32_t) (sj_random() % 100) + 1 <= percent );
+}
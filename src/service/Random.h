@@ -0,0 +1,60 @@
+/*
+ *   SniffJoke is a software able to confuse the Internet traffic analysis,
+ *   developed with the aim to improve digital privacy in communications and
+ *   to show and test some securiy weakness in traffic analysis software.
+ *   
+ *   Copyright (C) 2010, 2011 vecna <vecna@delirandom.net>
+ *                            evilaliv3 <giovanni.pellerano@evilaliv3.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SJ_RANDOM_H
+#define SJ_RANDOM_H
+
+#include <cstddef>
+#include <stdint.h>
+
+/*
+ * sniffjoke random engine: a xoshiro256++ generator for every thread, used in
+ * place of libc random() (that takes a lock and returns 31 bits for call),
+ * and a four lane version of the same generator for the bulk fill of the
+ * fake payloads, written with the gcc vector extension: the compiler use
+ * the SIMD registers available for the target.
+ *
+ * init_random() is the single seeding point: with a seed of 0 the seed is
+ * read from /dev/urandom, otherwise the sequences are reproducible (for the
+ * same thread creation order). every thread derive its own states from the
+ * seed and from its creation index.
+ *
+ * memset_random() takes the bytes from a per-thread pool when it has enough
+ * of them; random_pool_refill() generates the pool a chunk at time and must
+ * be called when the thread is idle. random_reseed_check() must be called at
+ * every cycle of the thread, busy or idle: it reseeds the thread from
+ * /dev/urandom every RANDOMPOOL_RESEED_TIMER seconds. with a fixed seed the
+ * pool and the reseed are disabled. clean_random() releases the pool.
+ */
+void init_random(uint32_t);
+uint32_t sj_random(void);
+uint64_t sj_random64(void);
+void* memset_random(void *, size_t);
+void random_pool_refill(void);
+void random_reseed_check(void);
+void clean_random(void);
+bool random_percent(int32_t percent);
+
+/* usable as RandomNumberGenerator in std::random_shuffle */
+ptrdiff_t random_index(ptrdiff_t);
+
+#endif /* SJ_RANDOM_H */
@@ -33,7 +33,19 @@ SessionTrack::SessionTrack(const Packet &pkt) :
 access_timestamp(0),
 daddr(pkt.ip->daddr),
 packet_number(0),
-injected_pktnumber(0)
+injected_pktnumber(0),
+first_seen(sj_clock),
+bytes(0),
+incoming_subscribers(0),
+plan_epoch(0),
+plan_ttlstatus(0),
+plan_scrambles(0),
+plan_aggid(0),
+plan_bulkdecay(false),
+plan_eligible(0),
+plan_always(0),
+plan_unmatched(0),
+refs(0)
 {
     if (pkt.proto == TCP)
     {
@@ -76,6 +88,24 @@ SessionTrack::~SessionTrack(void)
 #endif
 }
 
+/*
+ * a flow is a bulk transfer (an elephant, opposed to the short mice flows)
+ * when it has moved many bytes for some seconds at a sustained rate: a long
+ * idle connection returns a mouse when the rate drops.
+ */
+bool SessionTrack::isBulk(void) const
+{
+    if (bytes < BULKFLOW_MIN_BYTES)
+        return false;
+
+    const time_t lifetime = sj_clock - first_seen;
+
+    if (lifetime < BULKFLOW_MIN_SECONDS)
+        return false;
+
+    return (bytes / lifetime >= BULKFLOW_MIN_RATE);
+}
+
 void SessionTrack::selflog(const char *func, const char *format, ...) const
 {
     if (debug.level() == SUPPRESS_LEVEL)
@@ -176,6 +206,34 @@ SessionTrack& SessionTrackMap::get(const Packet &pkt)
     return *sessiontrack;
 }
 
+/*
+ * return the sessiontrack of the flow of a packet received from the network,
+ * keyed as the packets sent; NULL if no one exists, a new one is not created
+ */
+SessionTrack* SessionTrackMap::getIncoming(const Packet &pkt)
+{
+    SessionTrackKey key;
+    key.daddr = pkt.ip->saddr;
+    if (pkt.proto == TCP)
+    {
+        key.proto = IPPROTO_TCP;
+        key.sport = pkt.tcp->dest;
+        key.dport = pkt.tcp->source;
+    }
+    else /* (pkt.proto == UDP) */
+    {
+        key.proto = IPPROTO_UDP;
+        key.sport = pkt.udp->dest;
+        key.dport = pkt.udp->source;
+    }
+
+    SessionTrackMap::iterator it = find(key);
+    if (it == end())
+        return NULL;
+
+    return it->second;
+}
+
 void SessionTrackMap::manage(void)
 {
     /* timeout check */
@@ -184,7 +242,7 @@ void SessionTrackMap::manage(void)
         manage_timeout = sj_clock; /* update the next manage timeout */
         for (SessionTrackMap::iterator it = begin(); it != end();)
         {
-            if ((*it).second->access_timestamp + SESSIONTRACK_EXPIRYTIME < sj_clock)
+            if ((*it).second->access_timestamp + SESSIONTRACK_EXPIRYTIME < sj_clock && !(*it).second->refs)
             {
                 delete &(*it->second);
                 erase(it++);
@@ -223,13 +281,24 @@ void SessionTrackMap::manage(void)
         index = 0;
         do
         {
-            const SessionTrackKey key = {tmp[index]->daddr, tmp[index]->sport, tmp[index]->dport};
+            const SessionTrackKey key = {tmp[index]->proto, tmp[index]->daddr, tmp[index]->sport, tmp[index]->dport};
             insert(pair<SessionTrackKey, SessionTrack *>(key, tmp[index]));
         }
         while (++index != SESSIONTRACKMAP_MEMORY_THRESHOLD / 2);
 
+        /* the sessions referred by the packets in the queues are kept anyway */
         do
-            delete tmp[index];
+        {
+            if (!tmp[index]->refs)
+            {
+                delete tmp[index];
+            }
+            else
+            {
+                const SessionTrackKey key = {tmp[index]->proto, tmp[index]->daddr, tmp[index]->sport, tmp[index]->dport};
+                insert(pair<SessionTrackKey, SessionTrack *>(key, tmp[index]));
+            }
+        }
         while (++index != map_size);
 
         delete[] tmp;
@@ -43,9 +43,32 @@ public:
     uint32_t packet_number;
     uint32_t injected_pktnumber;
 
+    /* bytes of the packets in both the directions since first_seen, see isBulk() */
+    time_t first_seen;
+    uint64_t bytes;
+
+    /* bitmap of the plugins subscribed to the incoming packets, see PluginPool */
+    uint64_t incoming_subscribers;
+
+    /* the hack plan of the flow, see TCPTrack::updatePlan(): valid while the
+       port configuration (plan_epoch) and the ttl status don't change */
+    uint32_t plan_epoch;
+    uint8_t plan_ttlstatus;
+    uint8_t plan_scrambles;
+    uint16_t plan_aggid;
+    bool plan_bulkdecay;
+    uint64_t plan_eligible;
+    uint64_t plan_always;
+    uint64_t plan_unmatched;    /* no scramble in common, excluded only at PACKET_LEVEL */
+
+    /* packets carrying this session (see Packet::attachFlow): never expired while not 0 */
+    uint32_t refs;
+
     SessionTrack(const Packet &);
     ~SessionTrack(void);
 
+    bool isBulk(void) const;
+
     /* utilities */
     void selflog(const char *func, const char *format, ...) const;
 };
@@ -82,6 +105,7 @@ public:
     ~SessionTrackMap(void);
 
     SessionTrack& get(const Packet &);
+    SessionTrack* getIncoming(const Packet &);
     void manage(void);
 };
 
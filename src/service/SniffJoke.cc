@@ -20,6 +20,7 @@
  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "SniffJoke.h"
+#include "Checksum.h"
 
 #include <fcntl.h>
 #include <sys/types.h>
@@ -28,6 +29,7 @@
 /* global variables */
 time_t sj_clock;
 char sj_clock_str[MEDIUMBUF];
+uint64_t sj_clock_us;
 Debug debug;
 
 auto_ptr<UserConf> userconf;
@@ -109,6 +111,8 @@ void SniffJoke::run(void)
         proc->background();
     }
 
+    LOG_VERBOSE("checksum computed with the %s kernel", checksum_kernel_name());
+
     /* networkSetup read the config, the system and setup the local mitm */
     userconf->networkSetup();
 
@@ -191,6 +195,8 @@ void SniffJoke::updateClock(void)
 {
     sj_clock = time(NULL);
     strftime(sj_clock_str, sizeof (sj_clock_str), "%F %T", localtime(&sj_clock));
+
+    sj_clock_us = monotonicClockUs();
 }
 
 void SniffJoke::setupDebug(void)
@@ -398,6 +404,14 @@ uint8_t * SniffJoke::handleCmd(const char *cmd)
     {
         handleCmdShowport();
     }
+    else if (!memcmp(cmd, "holdstat", strlen("holdstat")))
+    {
+        handleCmdHoldstat();
+    }
+    else if (!memcmp(cmd, "budget", strlen("budget")))
+    {
+        handleCmdBudget();
+    }
     else if (!memcmp(cmd, "set", strlen("set")))
     {
         handleCmdSet(cmd);
@@ -497,6 +511,18 @@ void SniffJoke::handleCmdTTL(void)
     writeSJTTLmap(TTLMAP_COMMAND_TYPE);
 }
 
+void SniffJoke::handleCmdHoldstat(void)
+{
+    LOG_VERBOSE("holdstat command requested: dumping KEEP hold time histogram");
+    writeSJHoldStat(HOLDSTAT_COMMAND_TYPE);
+}
+
+void SniffJoke::handleCmdBudget(void)
+{
+    LOG_VERBOSE("budget command requested: dumping the injection budget");
+    writeSJBudget(BUDGET_COMMAND_TYPE);
+}
+
 void SniffJoke::handleCmdShowport(void)
 {
     LOG_VERBOSE("showport command requested: dumping port aggressivity and frequency");
@@ -526,6 +552,7 @@ void SniffJoke::handleCmdSet(const char* cmd)
     else
     {
         pl.mergeLine(userconf->runcfg.portconf);
+        conntrack->buildAggressivityTable();
     }
 
     writeSJPortStat(SETPORT_COMMAND_TYPE);
@@ -607,6 +634,7 @@ void SniffJoke::writeSJStatus(uint8_t commandReceived)
     accumulen += appendSJStatus(&io_buf[accumulen], STAT_GROUP, strlen(userconf->runcfg.group), userconf->runcfg.group);
     accumulen += appendSJStatus(&io_buf[accumulen], STAT_LOCAT, strlen(userconf->runcfg.location), userconf->runcfg.location);
     accumulen += appendSJStatus(&io_buf[accumulen], STAT_CHAINING, sizeof (userconf->runcfg.chaining), userconf->runcfg.chaining);
+    accumulen += appendSJStatus(&io_buf[accumulen], STAT_OPTIMISTIC, sizeof (userconf->runcfg.optimistic), userconf->runcfg.optimistic);
     accumulen += appendSJStatus(&io_buf[accumulen], STAT_NO_TCP, sizeof (userconf->runcfg.no_tcp), userconf->runcfg.no_tcp);
     accumulen += appendSJStatus(&io_buf[accumulen], STAT_NO_UDP, sizeof (userconf->runcfg.no_udp), userconf->runcfg.no_udp);
 
@@ -645,6 +673,63 @@ void SniffJoke::writeSJTTLmap(uint8_t type)
     memcpy(io_buf, &retInfo, sizeof (retInfo));
 }
 
+void SniffJoke::writeSJHoldStat(uint8_t type)
+{
+    struct command_ret retInfo;
+    struct hold_record records[HOLDSTAT_BUCKETS];
+
+    /* clean the buffer and fix the starting pointer */
+    memset(io_buf, 0x00, sizeof (io_buf));
+
+    conntrack->dumpHoldHistogram(records);
+    memcpy(&io_buf[sizeof (retInfo)], records, sizeof (records));
+
+    retInfo.cmd_len = sizeof (retInfo) + sizeof (records);
+    retInfo.cmd_type = type;
+    memcpy(io_buf, &retInfo, sizeof (retInfo));
+}
+
+void SniffJoke::writeSJBudget(uint8_t type)
+{
+    struct command_ret retInfo;
+    struct budget_record record;
+    uint32_t accumulen = sizeof (retInfo);
+
+    /* clean the buffer and fix the starting pointer */
+    memset(io_buf, 0x00, sizeof (io_buf));
+
+    conntrack->dumpBudget(&record);
+    memcpy(&io_buf[accumulen], &record, sizeof (record));
+    accumulen += sizeof (record);
+
+    /* only the destinations where the budget has acted */
+    for (TTLFocusMap::iterator it = ttlfocus_map->begin(); it != ttlfocus_map->end(); ++it)
+    {
+        const TTLFocus &TT = *((*it).second);
+
+        if (!TT.budget_injected && !TT.budget_refused)
+            continue;
+
+        if (accumulen > sizeof (io_buf) - sizeof (struct budget_record))
+        {
+            LOG_ALL("overflow trapped! io_buf %u bytes are not enought!", sizeof (io_buf));
+            break;
+        }
+
+        record.daddr = TT.daddr;
+        record.tokens = userconf->runcfg.budget_percent ? TT.budget_tokens : 0xffffffff;
+        record.injected = TT.budget_injected;
+        record.refused = TT.budget_refused;
+
+        memcpy(&io_buf[accumulen], &record, sizeof (record));
+        accumulen += sizeof (record);
+    }
+
+    retInfo.cmd_len = accumulen;
+    retInfo.cmd_type = type;
+    memcpy(io_buf, &retInfo, sizeof (retInfo));
+}
+
 void SniffJoke::writeSJInfoDump(uint8_t type)
 {
     struct command_ret retInfo;
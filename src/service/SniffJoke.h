@@ -85,6 +85,8 @@ private:
     void handleCmdStat(void);
     void handleCmdInfo(void);
     void handleCmdTTL(void);
+    void handleCmdHoldstat(void);
+    void handleCmdBudget(void);
     void handleCmdShowport(void);
     void handleCmdSet(const char *);
     void handleCmdDebuglevel(uint8_t);
@@ -94,6 +96,8 @@ private:
     void writeSJPortStat(uint8_t);
     void writeSJInfoDump(uint8_t);
     void writeSJTTLmap(uint8_t);
+    void writeSJHoldStat(uint8_t);
+    void writeSJBudget(uint8_t);
     void writeSJProtoError(void);
 
     /* called by writeSJ* functions = answer building */
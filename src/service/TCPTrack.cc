@@ -27,16 +27,30 @@
 #include "SessionTrack.h"
 #include "TTLFocus.h"
 #include "PluginPool.h"
+#include "PacketView.h"
 
 extern auto_ptr<UserConf> userconf;
 extern auto_ptr<SessionTrackMap> sessiontrack_map;
 extern auto_ptr<TTLFocusMap> ttlfocus_map;
 extern auto_ptr<PluginPool> plugin_pool;
 
-TCPTrack::TCPTrack()
+/* upper limits in milliseconds of the hold time buckets */
+static const uint32_t holdBucketLimit[HOLDSTAT_BUCKETS - 1] = {
+    1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000
+};
+
+TCPTrack::TCPTrack() :
+pacing_now(0),
+plan_epoch(0),
+budget_tokens(max((uint32_t) userconf->runcfg.budget_kbps * 125, (uint32_t) BUDGET_GLOBAL_MIN_BURST)),
+budget_refill_us(sj_clock_us),
+budget_injected(0),
+budget_refused(0)
 {
     LOG_DEBUG("");
 
+    memset(hold_histogram, 0, sizeof (hold_histogram));
+
     mangled_proto_mask = ICMP;
 
     if (!userconf->runcfg.no_tcp)
@@ -44,14 +58,26 @@ TCPTrack::TCPTrack()
 
     if (!userconf->runcfg.no_udp)
         mangled_proto_mask |= UDP;
+
+    buildAggressivityTable();
 }
 
 TCPTrack::~TCPTrack(void)
 {
     LOG_DEBUG("");
+
+    for (uint8_t i = PKTCHECK_OK + 1; i < PKTCHECK_REASONS; ++i)
+    {
+        if (Packet::rejectedCounter[i])
+            LOG_ALL("dropped %u malformed packets: %s", Packet::rejectedCounter[i], Packet::getCheckStr((pktcheck_t) i));
+    }
 }
 
-uint32_t TCPTrack::derivePercentage(uint32_t packet_number, uint16_t frequencyValue)
+/*
+ * the percentage for a packet number and a clock phase ((uint8_t) sj_clock % 20):
+ * used only by buildAggressivityTable(), the per packet decision reads the table.
+ */
+uint32_t TCPTrack::derivePercentage(uint32_t packet_number, uint8_t phase, uint16_t frequencyValue)
 {
 
     if (userconf->runcfg.onlyplugin[0])
@@ -95,14 +121,14 @@ uint32_t TCPTrack::derivePercentage(uint32_t packet_number, uint16_t frequencyVa
     }
     if (frequencyValue & AGG_TIMEBASED5S)
     {
-        if (!((uint8_t) sj_clock % 5))
+        if (!(phase % 5))
             freqret += 90;
         else
             freqret += 2;
     }
     if (frequencyValue & AGG_TIMEBASED20S)
     {
-        if (!((uint8_t) sj_clock % 20))
+        if (!(phase % 20))
             freqret += 90;
         else
             freqret += 2;
@@ -139,50 +165,104 @@ uint32_t TCPTrack::derivePercentage(uint32_t packet_number, uint16_t frequencyVa
 }
 
 /*
- *  this function is used from the injectHack() routine to decretee
- *  the possibility for an hack to happen.
- *  returns true if it's possibile to forge the hack.
- *  the calculation involves:
- *   - the session packet count; a variable inside the equation (some hacks are
- *     configured to act in peek time or packets number relationship)
- *   - the frequency selector provided from the hack developer; used when the
- *     port-aggressivity.conf file don't provide a specific configuration.
- *   - the port configuration settings: derived from 'port-aggressivity.conf'
+ * the tables are rebuilt at the start and when the port configuration
+ * changes (sniffjokectl set/clear): the percentage of every aggressivity
+ * in use is precomputed for every packet number class and clock phase.
  */
-bool TCPTrack::percentage(uint32_t packet_number, uint16_t hackFrequency, uint16_t userFrequency)
+uint16_t TCPTrack::addAggressivity(uint16_t frequencyValue)
 {
-    uint32_t aggressivity_percentage = 0;
+    for (uint16_t id = 0; id < agg_tables.size(); ++id)
+    {
+        if (agg_tables[id].frequency == frequencyValue)
+            return id;
+    }
 
-    /*
-     * as first is checked hackFrequency, because it could be AGG_ALWAYS
-     * and this means that we are in testing mode with --only-olugin option
-     */
-    if (hackFrequency & AGG_ALWAYS)
-        return true;
+    aggressivityTable table;
+    table.frequency = frequencyValue;
+
+    for (uint32_t pktclass = 0; pktclass < AGG_PKTCLASSES; ++pktclass)
+    {
+        for (uint8_t phase = 0; phase < AGG_PHASES; ++phase)
+        {
+            const uint32_t freqret = derivePercentage(pktclass, phase, frequencyValue);
+            table.percentage[pktclass][phase] = freqret > 100 ? 100 : freqret;
+        }
+    }
 
-    aggressivity_percentage = derivePercentage(packet_number, userFrequency);
+    agg_tables.push_back(table);
 
-    return ( ((uint32_t) random() % 100) < aggressivity_percentage);
+    return agg_tables.size() - 1;
 }
 
-uint16_t TCPTrack::getUserFrequency(const Packet &pkt)
+void TCPTrack::buildAggressivityTable(void)
 {
-    /* MUST be called on TCP/UDP packet only */
+    agg_tables.clear();
+    agg_tcp_id.resize(PORTSNUMBER);
 
-    if (pkt.proto == TCP)
-        return userconf->runcfg.portconf[ntohs(pkt.tcp->dest)];
+    for (uint32_t port = 0; port < PORTSNUMBER; ++port)
+        agg_tcp_id[port] = addAggressivity(userconf->runcfg.portconf[port]);
 
-    /* else, no other proto other than UDP will reach here.
-     *
+    /*
      * the UDP traffic is for the most a data-apply hacks, because no flag gaming
      * nor sequence hack exists. when a service is request to be ALWAYS hacked, we
      * accept this choose in UDP too. otherwise, is better use a costant noise
-     * using AGG_COMMON */
+     * using AGG_COMMON
+     */
+    agg_udp_always_id = addAggressivity(AGG_ALWAYS);
+    agg_udp_common_id = addAggressivity(AGG_COMMON);
 
-    if (userconf->runcfg.portconf[ntohs(pkt.udp->dest)] == AGG_ALWAYS)
-        return AGG_ALWAYS;
+    ++plan_epoch;
 
-    return AGG_COMMON;
+    LOG_DEBUG("%u aggressivity tables built", (uint32_t) agg_tables.size());
+}
+
+/* the aggressivity table of the session, MUST be called on TCP/UDP packet only */
+uint16_t TCPTrack::aggressivityId(const Packet &pkt) const
+{
+    if (pkt.proto == TCP)
+        return agg_tcp_id[ConstTcpView(pkt).dport()];
+
+    if (userconf->runcfg.portconf[ConstUdpView(pkt).dport()] == AGG_ALWAYS)
+        return agg_udp_always_id;
+
+    return agg_udp_common_id;
+}
+
+uint8_t TCPTrack::aggressivityOf(uint16_t id, uint32_t packet_number) const
+{
+    const uint32_t pktclass = packet_number < AGG_PKTCLASS_EXACT ?
+            packet_number : AGG_PKTCLASS_EXACT + packet_number % 30;
+
+    return agg_tables[id].percentage[pktclass][(uint8_t) sj_clock % AGG_PHASES];
+}
+
+/*
+ * the sessions of the ports configured with BULKDECAY, once classified as
+ * bulk transfers, halve the aggressivity every BULKDECAY_HALFLIFE_BYTES
+ * moved: the fake segments don't double a long download, while the
+ * handshake and the short flows keep the full aggressivity.
+ */
+uint8_t TCPTrack::bulkDecay(const SessionTrack &sessiontrack, uint8_t aggressivity)
+{
+    const uint64_t halvings = 1 + (sessiontrack.bytes - BULKFLOW_MIN_BYTES) / BULKDECAY_HALFLIFE_BYTES;
+
+    return (halvings >= 8) ? 0 : (aggressivity >> halvings);
+}
+
+/*
+ *  this function is used from the injectHack() routine to decretee
+ *  the possibility for an hack to happen.
+ *  returns true if it's possibile to forge the hack.
+ *  the calculation involves the aggressivity of the session, from
+ *  aggressivityOf(): derived from 'port-aggressivity.conf' and the session
+ *  packet count (some hacks are configured to act in peek time or packets
+ *  number relationship). the frequency selector provided from the hack
+ *  developer is AGG_ALWAYS in testing mode (--only-plugin option): those
+ *  plugins are in the plan_always bitmap and this function is not called.
+ */
+bool TCPTrack::percentage(uint8_t aggressivity)
+{
+    return ( ((uint32_t) sj_random() % 100) < aggressivity);
 }
 
 uint8_t TCPTrack::discernAvailScramble(const Packet &pkt)
@@ -194,13 +274,208 @@ uint8_t TCPTrack::discernAvailScramble(const Packet &pkt)
      */
     uint8_t retval = SCRAMBLE_INNOCENT | SCRAMBLE_CHECKSUM | SCRAMBLE_MALFORMED;
 
-    TTLFocus &ttlfocus = ttlfocus_map->get(pkt);
-    if (ttlfocus.status == TTL_KNOWN)
+    if (pkt.ttlfocus->status == TTL_KNOWN)
         retval |= SCRAMBLE_TTL;
 
     return retval;
 }
 
+/*
+ * the hack plan of a flow: the scrambles available toward the destination,
+ * the plugins sharing none of them, those forcing the hack (AGG_ALWAYS) and the
+ * aggressivity table of the port. it depends only on the ttl status and on
+ * the port configuration, so it is recomputed when one of them changes and
+ * the selection of every packet walks a bitmap. the phase of the session
+ * (handshake, peeks) is in the aggressivity table, indexed by packet number.
+ */
+void TCPTrack::updatePlan(SessionTrack &sessiontrack, const Packet &pkt)
+{
+    const ttlsearch_t ttlstatus = pkt.ttlfocus->status;
+
+    if (sessiontrack.plan_epoch == plan_epoch && sessiontrack.plan_ttlstatus == ttlstatus)
+        return;
+
+    sessiontrack.plan_epoch = plan_epoch;
+    sessiontrack.plan_ttlstatus = ttlstatus;
+    sessiontrack.plan_scrambles = discernAvailScramble(pkt);
+    sessiontrack.plan_aggid = aggressivityId(pkt);
+    sessiontrack.plan_bulkdecay = (agg_tables[sessiontrack.plan_aggid].frequency & AGG_BULKDECAY);
+    sessiontrack.plan_eligible = 0;
+    sessiontrack.plan_always = 0;
+    sessiontrack.plan_unmatched = 0;
+
+    for (uint8_t i = 0; i < plugin_pool->pool.size(); ++i)
+    {
+        const Plugin &plugin = *plugin_pool->pool[i]->selfObj;
+
+        /*
+         * this represents a preliminar check common to all hacks.
+         * more specific ones related to the origpkt will be checked in
+         * the condition function implemented by a specific hack.
+         * as it has always been, the plugin is excluded only at
+         * PACKET_LEVEL (see injectHack), otherwise condition() decides.
+         */
+        if (!(sessiontrack.plan_scrambles & plugin.supportedScrambles))
+            sessiontrack.plan_unmatched |= ((uint64_t) 1 << i);
+
+        sessiontrack.plan_eligible |= ((uint64_t) 1 << i);
+
+        if (plugin.pluginFrequency & AGG_ALWAYS)
+            sessiontrack.plan_always |= ((uint64_t) 1 << i);
+    }
+
+    sessiontrack.SELFLOG("hack plan updated: %u eligible plugins, ttl status %u",
+                         (uint32_t) __builtin_popcountll(sessiontrack.plan_eligible), (uint32_t) ttlstatus);
+}
+
+/*
+ * the packets held in KEEP for a destination are moved in the HACK queue
+ * when the ttl bruteforce ends (status KNOWN or UNKNOWN): the status
+ * changes only in extractTTLinfo() and injectTTLProbe(), so the KEEP queue
+ * is never scanned.
+ */
+void TCPTrack::releaseKeepPackets(TTLFocus &ttlfocus)
+{
+    for (vector<Packet *>::iterator it = ttlfocus.keep_pkts.begin(); it != ttlfocus.keep_pkts.end(); ++it)
+    {
+        const uint64_t hold_ms = (sj_clock_us - (*it)->keep_timestamp) / 1000;
+
+        uint8_t i = 0;
+        while (i < HOLDSTAT_BUCKETS - 1 && hold_ms >= holdBucketLimit[i])
+            ++i;
+
+        ++hold_histogram[i];
+
+        p_queue.insert(**it, HACK);
+    }
+
+    ttlfocus.keep_pkts.clear();
+}
+
+/*
+ * with max-hold-ms configured, the destinations having the oldest KEEP
+ * packet over the limit are released without waiting the bruteforce:
+ * discernAvailScramble() does not offer the TTL scramble until the status
+ * is KNOWN, and the next packets of the destinations are not held anymore.
+ * the KEEP queue is in insertion order, so only its front is checked.
+ */
+void TCPTrack::expireKeepPackets(void)
+{
+    if (!userconf->runcfg.max_hold_ms)
+        return;
+
+    const uint64_t max_hold_us = (uint64_t) userconf->runcfg.max_hold_ms * 1000;
+
+    Packet *pkt;
+    for (p_queue.select(KEEP); ((pkt = p_queue.get()) != NULL); p_queue.select(KEEP))
+    {
+        if (pkt->keep_timestamp + max_hold_us > sj_clock_us)
+            break;
+
+        TTLFocus &ttlfocus = *pkt->ttlfocus;
+
+        ttlfocus.SELFLOG("hold time expired, releasing %u packets", (uint32_t) ttlfocus.keep_pkts.size());
+
+        ttlfocus.hold_expired = true;
+        releaseKeepPackets(ttlfocus);
+    }
+}
+
+/*
+ * the injection budget: a destination can receive injected bytes up to
+ * budget_percent of the real bytes sent to it, after a first allowance of
+ * BUDGET_DEST_BURST bytes for the handshake; all the destinations together
+ * up to budget_kbps, with a burst of one second. 0 is unlimited for both.
+ */
+void TCPTrack::creditBudget(TTLFocus &ttlfocus, uint32_t realbytes)
+{
+    const uint32_t credit = realbytes * userconf->runcfg.budget_percent / 100;
+
+    ttlfocus.budget_tokens = min(ttlfocus.budget_tokens + credit, (uint32_t) BUDGET_DEST_BURST);
+}
+
+/*
+ * returns false when the estimated bytes of a hack are over one of the
+ * budgets: it is called before apply(), because the state kept by a plugin
+ * (the cache, the flow subscription) must never outlive a discarded output.
+ */
+bool TCPTrack::affordBudget(TTLFocus &ttlfocus, uint32_t estimate)
+{
+    const uint16_t budget_percent = userconf->runcfg.budget_percent;
+    const uint16_t budget_kbps = userconf->runcfg.budget_kbps;
+
+    if (budget_kbps)
+    {
+        /* kbps * 1000 / 8 bytes every second: a byte every 8000 / kbps microseconds */
+        const uint64_t depth = max((uint32_t) budget_kbps * 125, (uint32_t) BUDGET_GLOBAL_MIN_BURST);
+        const uint64_t refill = (sj_clock_us - budget_refill_us) * budget_kbps / 8000;
+
+        if (refill)
+        {
+            budget_refill_us += refill * 8000 / budget_kbps;
+            budget_tokens = min(budget_tokens + refill, depth);
+        }
+    }
+
+    if ((budget_percent && (!ttlfocus.budget_tokens || ttlfocus.budget_tokens < estimate)) ||
+            (budget_kbps && (!budget_tokens || budget_tokens < estimate)))
+    {
+        ++ttlfocus.budget_refused;
+        ++budget_refused;
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * charges the real bytes of an accepted hack: the estimate can be lower,
+ * so the tokens stop at 0 and the overrun is at most the output of a hack.
+ */
+void TCPTrack::chargeBudget(TTLFocus &ttlfocus, uint32_t bytes)
+{
+    if (userconf->runcfg.budget_percent)
+        ttlfocus.budget_tokens -= min(ttlfocus.budget_tokens, bytes);
+
+    if (userconf->runcfg.budget_kbps)
+        budget_tokens -= min(budget_tokens, bytes);
+
+    ttlfocus.budget_injected += bytes;
+    budget_injected += bytes;
+}
+
+/* an insertion sort: it's stable, so the plugins of the same cost keep the random order */
+void TCPTrack::sortByCost(PluginTrack **hacks, uint8_t num)
+{
+    for (uint8_t i = 1; i < num; ++i)
+    {
+        PluginTrack * const pt = hacks[i];
+
+        uint8_t j = i;
+        for (; j && hacks[j - 1]->avg_cost > pt->avg_cost; --j)
+            hacks[j] = hacks[j - 1];
+
+        hacks[j] = pt;
+    }
+}
+
+void TCPTrack::dumpBudget(struct budget_record *record) const
+{
+    record->daddr = 0;
+    record->tokens = userconf->runcfg.budget_kbps ? budget_tokens : 0xffffffff;
+    record->injected = budget_injected;
+    record->refused = budget_refused;
+}
+
+void TCPTrack::dumpHoldHistogram(struct hold_record *records) const
+{
+    for (uint8_t i = 0; i < HOLDSTAT_BUCKETS; ++i)
+    {
+        records[i].upto_ms = (i < HOLDSTAT_BUCKETS - 1) ? holdBucketLimit[i] : 0;
+        records[i].packets = hold_histogram[i];
+    }
+}
+
 /*
  * this function is responsable of the ttl bruteforce stage used
  * to detect the hop distance between us and the remote peer.
@@ -227,6 +502,7 @@ void TCPTrack::injectTTLProbe(TTLFocus &ttlfocus)
     {
     case TTL_UNKNOWN:
         ttlfocus.status = TTL_BRUTEFORCE;
+        ttlfocus.hold_expired = false;
         /* do not break, continue inside TTL_BRUTEFORCE */
     case TTL_BRUTEFORCE:
         if (ttlfocus.sent_probe == userconf->runcfg.max_ttl_probe)
@@ -243,6 +519,7 @@ void TCPTrack::injectTTLProbe(TTLFocus &ttlfocus)
                 ttlfocus.ttl_estimate = 0xFF;
                 ttlfocus.ttl_synack = 0;
                 ttlfocus.next_probe_time = sj_clock + TTLPROBE_RETRY_ON_UNKNOWN;
+                releaseKeepPackets(ttlfocus);
             }
             break;
         }
@@ -281,7 +558,8 @@ void TCPTrack::execTTLBruteforces(void)
     {
         TTLFocus &ttlfocus = *((*it).second);
         if ((ttlfocus.status != TTL_KNOWN) /* 1) the ttl is BRUTEFORCE or UNKNOWN */
-                && (ttlfocus.access_timestamp > (sj_clock - 30)) /* 2) the destination it's used in the last 30 seconds */
+                && ((ttlfocus.access_timestamp > (sj_clock - 30)) /* 2) the destination it's used in the last 30 seconds */
+                || !ttlfocus.keep_pkts.empty()) /*    or has packets in KEEP */
                 && (ttlfocus.next_probe_time <= sj_clock)) /* 3) the next probe time it's passed */
         {
             injectTTLProbe(*(*it).second);
@@ -353,6 +631,7 @@ bool TCPTrack::extractTTLinfo(const Packet &incompkt)
                      */
                     ttlfocus->status = TTL_UNKNOWN;
                     ttlfocus->ttl_estimate = expired_ttl + 1;
+                    releaseKeepPackets(*ttlfocus);
                 }
             }
 
@@ -398,6 +677,7 @@ bool TCPTrack::extractTTLinfo(const Packet &incompkt)
         }
 
         ttlfocus->status = TTL_KNOWN;
+        releaseKeepPackets(*ttlfocus);
 
         incompkt.SELFLOG("incoming SYN/ACK puppet|%d ttl_estimate|%d ttl_synack|%d",
                          ttlfocus->puppet_port, ttlfocus->ttl_estimate, ttlfocus->ttl_synack);
@@ -420,33 +700,90 @@ bool TCPTrack::extractTTLinfo(const Packet &incompkt)
 }
 
 /*
- * notifies all plugins at the arrival of an incoming packet;
- * if a plugin does not need this notification simply can return immediatly.
+ * notifies the plugins subscribed to the packets of a batch of incoming
+ * packets, with one call for every plugin receiving some of them: the
+ * subscriptions by class and port are indexed by PluginPool, the ones
+ * for the flow are in the SessionTrack of the outgoing direction.
+ * with no subscriber a packet costs no call at all.
  *
- * the function returns TRUE if a plugins has requested the removal of the packet.
+ * remove[i] is set TRUE if a plugin has requested the removal of pkts[i].
  */
 #define ENABLE_INCOMING_DEBUG
 /* at the moment, only few plugins mangle the input packet, enable this debug when needed */
 #undef ENABLE_INCOMING_DEBUG
 
-bool TCPTrack::notifyIncoming(Packet &origpkt)
+void TCPTrack::notifyIncomingBatch(Packet * const *pkts, uint8_t count, bool *remove)
 {
-    bool removeOrig = false;
-
 #ifdef ENABLE_INCOMING_DEBUG
-    origpkt.SELFLOG("orig pkt: before incoming mangle");
+    for (uint8_t i = 0; i < count; ++i)
+        pkts[i]->SELFLOG("orig pkt: before incoming mangle");
 #endif
 
-    for (vector<PluginTrack*>::iterator it = plugin_pool->pool.begin(); it != plugin_pool->pool.end(); ++it)
+    uint64_t subscribers[PKTBATCH_SIZE];
+    uint64_t all_subscribers = 0;
+
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        subscribers[i] = plugin_pool->incomingSubscribers(*pkts[i]);
+
+        if (pkts[i]->proto & (TCP | UDP))
+        {
+            SessionTrack * const sessiontrack = sessiontrack_map->getIncoming(*pkts[i]);
+            if (sessiontrack != NULL)
+            {
+                /* the received bytes count in the classification of the flow */
+                sessiontrack->bytes += pkts[i]->pbuf.size();
+                subscribers[i] |= sessiontrack->incoming_subscribers;
+            }
+        }
+
+        all_subscribers |= subscribers[i];
+    }
+
+    for (uint8_t p = 0; all_subscribers; ++p, all_subscribers >>= 1)
     {
-        PluginTrack *pt = *it;
+        if (!(all_subscribers & 1))
+            continue;
+
+        PluginTrack *pt = plugin_pool->pool[p];
+        const uint64_t bit = (uint64_t) 1 << p;
 
-        pt->selfObj->mangleIncoming(origpkt);
+        Packet *subpkts[PKTBATCH_SIZE];
+        bool subremove[PKTBATCH_SIZE];
+        uint8_t subindex[PKTBATCH_SIZE];
+        uint8_t subcount = 0;
+
+        for (uint8_t i = 0; i < count; ++i)
+        {
+            if (subscribers[i] & bit)
+            {
+                subpkts[subcount] = pkts[i];
+                subremove[subcount] = false;
+                subindex[subcount++] = i;
+            }
+        }
+
+        const bool subscribed = (pt->selfObj->incomingProtos != 0);
+
+        pt->selfObj->mangleIncomingBatch(subpkts, subcount, subremove);
+
+        for (uint8_t i = 0; i < subcount; ++i)
+        {
+            if (subremove[i])
+                remove[subindex[i]] = true;
+        }
+
+        /* the default mangleIncoming() has been reached: the plugin is not interested */
+        if (subscribed && !pt->selfObj->incomingProtos)
+        {
+            LOG_DEBUG("%s does not handle the incoming packets: unsubscribed", pt->selfObj->pluginName);
+            plugin_pool->buildIncomingIndex();
+        }
 
         /* it will be rare for a hack mangleIncoming to generate one or more packet, anyway we keep this possibility possible */
-        for (vector<Packet*>::iterator hack_it = pt->selfObj->pktVector.begin(); hack_it < pt->selfObj->pktVector.end(); ++hack_it)
+        for (uint8_t j = 0; j < pt->selfObj->pktVectorNum; ++j)
         {
-            Packet &injpkt = **hack_it;
+            Packet &injpkt = *pt->selfObj->pktVector[j];
 
             if (!injpkt.selfIntegrityCheck(pt->selfObj->pluginName))
             {
@@ -467,9 +804,7 @@ bool TCPTrack::notifyIncoming(Packet &origpkt)
                 continue;
 
 #ifdef ENABLE_INCOMING_DEBUG
-            injpkt.SELFLOG("%s: generated packet, the original (i%u) will be %s",
-                           pt->selfObj->pluginName, origpkt.SjPacketId,
-                           pt->selfObj->removeOrigPkt ? "REMOVED" : "KEPT");
+            injpkt.SELFLOG("%s: generated packet from an incoming batch of %u", pt->selfObj->pluginName, count);
 #endif
 
             /* injpkt.position is ignored in this section because mangleIncoming
@@ -479,15 +814,22 @@ bool TCPTrack::notifyIncoming(Packet &origpkt)
             p_queue.insert(injpkt, SEND);
         }
 
-        if (pt->selfObj->removeOrigPkt == true)
-            removeOrig = true;
-
         pt->selfObj->reset();
     }
 
 #ifdef ENABLE_INCOMING_DEBUG
-    origpkt.SELFLOG("orig pkt: after incoming mangle");
+    for (uint8_t i = 0; i < count; ++i)
+        pkts[i]->SELFLOG("orig pkt: after incoming mangle, %s", remove[i] ? "REMOVED" : "KEPT");
 #endif
+}
+
+/* the function returns TRUE if a plugins has requested the removal of the packet. */
+bool TCPTrack::notifyIncoming(Packet &origpkt)
+{
+    Packet * const pkts[1] = { &origpkt };
+    bool removeOrig = false;
+
+    notifyIncomingBatch(pkts, 1, &removeOrig);
 
     return removeOrig;
 }
@@ -500,74 +842,120 @@ bool TCPTrack::injectHack(Packet &origpkt)
 {
     bool removeOrig = false;
 
-    SessionTrack &sessiontrack = sessiontrack_map->get(origpkt);
+    SessionTrack &sessiontrack = *origpkt.sessiontrack;
 
-    vector<PluginTrack *> applicable_hacks;
+    /* no allocation in this path: at most one entry for every plugin of the pool */
+    PluginTrack *applicable_hacks[PLUGINPOOL_MAX];
+    uint8_t applicable_num = 0;
 
     /*
      * Not all time we have a scramble available, we tell to the plugin which of
      * them are usable, and the packets is returned. the most of the time, all of
      * three scramble are available, and the plugins will use pktRandomDamage()
-     * private method.
+     * private method. the scrambles are kept in the plan of the flow.
      */
-    uint8_t availableScrambles = discernAvailScramble(origpkt);
+    updatePlan(sessiontrack, origpkt);
 
-    char availableScramblesStr[LARGEBUF] = {0};
-    snprintfScramblesList(availableScramblesStr, sizeof (availableScramblesStr), availableScrambles);
+    const uint8_t availableScrambles = sessiontrack.plan_scrambles;
 
     /* SELECT APPLICABLE HACKS, the selection are base on:
+     * 0) the plan of the flow and the classes of packets declared by the plugin
+     *    (see updatePlan and PluginPool::buildCandidateIndex)
      * 1) the plugin/hacks detect if the condition exists (eg: the hack wants a SYN and the packet is a RST+ACK)
      * 2) compute the percentage: mixing the hack-choosed and the user-choose  */
-    for (vector<PluginTrack*>::iterator it = plugin_pool->pool.begin(); it != plugin_pool->pool.end(); ++it)
-    {
+    uint8_t aggressivity = aggressivityOf(sessiontrack.plan_aggid, sessiontrack.packet_number);
 
-        PluginTrack *pt = *it;
+    if (sessiontrack.plan_bulkdecay && sessiontrack.isBulk())
+        aggressivity = bulkDecay(sessiontrack, aggressivity);
 
-        /*
-         * this represents a preliminar check common to all hacks.
-         * more specific ones related to the origpkt will be checked in
-         * the condition function implemented by a specific hack.
-         */
-        if ((!(availableScrambles & pt->selfObj->supportedScrambles)) && (userconf->runcfg.debug_level == PACKET_LEVEL))
+    uint64_t candidates = plugin_pool->candidates(origpkt) & sessiontrack.plan_eligible;
+
+    if ((candidates & sessiontrack.plan_unmatched) && (userconf->runcfg.debug_level == PACKET_LEVEL))
+    {
+        char availableScramblesStr[LARGEBUF] = {0};
+        snprintfScramblesList(availableScramblesStr, sizeof (availableScramblesStr), availableScrambles);
+
+        for (uint8_t i = 0; i < plugin_pool->pool.size(); ++i)
         {
+            if (!(((candidates & sessiontrack.plan_unmatched) >> i) & 1))
+                continue;
+
             char pluginavaileScrambStr[LARGEBUF] = {0};
+            snprintfScramblesList(pluginavaileScrambStr, sizeof (pluginavaileScrambStr), plugin_pool->pool[i]->selfObj->supportedScrambles);
+
+            origpkt.SELFLOG("%s: no scramble matching between system avail [%s] and plugins scramble [%s]",
+                            plugin_pool->pool[i]->selfObj->pluginName, availableScramblesStr, pluginavaileScrambStr);
+        }
 
-            snprintfScramblesList(pluginavaileScrambStr, sizeof (pluginavaileScrambStr), pt->selfObj->supportedScrambles);
+        candidates &= ~sessiontrack.plan_unmatched;
+    }
 
-            origpkt.SELFLOG("%s: no scramble matching between system avail [%s] and plugins scramble [%s]",
-                            pt->selfObj->pluginName, availableScramblesStr, pluginavaileScrambStr);
+    for (uint8_t i = 0; candidates; ++i, candidates >>= 1)
+    {
+        if (!(candidates & 1))
             continue;
-        }
 
-        bool applicable = true;
+        PluginTrack *pt = plugin_pool->pool[i];
+
+        bool applicable = pt->selfObj->condition(origpkt, availableScrambles);
 
-        applicable &= pt->selfObj->condition(origpkt, availableScrambles);
-        applicable &= percentage(sessiontrack.packet_number, pt->selfObj->pluginFrequency, getUserFrequency(origpkt));
+        if (applicable && !((sessiontrack.plan_always >> i) & 1))
+            applicable = percentage(aggressivity);
 
         if (applicable)
-            applicable_hacks.push_back(pt);
+            applicable_hacks[applicable_num++] = pt;
     }
 
-    if (!applicable_hacks.size() && (userconf->runcfg.debug_level == PACKET_LEVEL))
+    if (!applicable_num && (userconf->runcfg.debug_level == PACKET_LEVEL))
         origpkt.SELFLOG("NONE hack plugin has been passed the selection!");
 
     /* -- RANDOMIZE HACKS APPLICATION */
-    random_shuffle(applicable_hacks.begin(), applicable_hacks.end());
+    random_shuffle(applicable_hacks, applicable_hacks + applicable_num, random_index);
+
+    /* with an injection budget the cheapest hacks are applied first */
+    const bool budget = (userconf->runcfg.budget_percent || userconf->runcfg.budget_kbps);
+    if (budget)
+        sortByCost(applicable_hacks, applicable_num);
 
     /* -- FINALLY, HACK THE CHOOSEN PACKET(S) */
-    for (vector<PluginTrack *>::iterator it = applicable_hacks.begin(); it != applicable_hacks.end(); ++it)
+    for (uint8_t i = 0; i < applicable_num; ++i)
     {
 
-        PluginTrack *pt = *it;
+        PluginTrack *pt = applicable_hacks[i];
 
         origpkt.SELFLOG("from %d avail plugins, %d has been selected: applying plugin [%s]", 
-                        plugin_pool->pool.size(), applicable_hacks.size(), pt->selfObj->pluginName);
+                        plugin_pool->pool.size(), applicable_num, pt->selfObj->pluginName);
+
+        /* the budget is checked before apply(), so an output is never discarded */
+        if (budget && !affordBudget(*origpkt.ttlfocus, pt->avg_cost))
+        {
+            origpkt.SELFLOG("%s: about %u bytes over the injection budget, skipped", pt->selfObj->pluginName, pt->avg_cost);
+            continue;
+        }
 
         pt->selfObj->apply(origpkt, availableScrambles);
 
-        for (vector<Packet*>::iterator hack_it = pt->selfObj->pktVector.begin(); hack_it < pt->selfObj->pktVector.end(); ++hack_it)
+        /* the plugin wants the incoming packets of this flow */
+        if (pt->selfObj->subscribeFlow)
+        {
+            sessiontrack.incoming_subscribers |= ((uint64_t) 1 << pt->poolIndex);
+            pt->selfObj->subscribeFlow = false;
+        }
+
+        if (budget)
+        {
+            uint32_t cost = 0;
+            for (uint8_t j = 0; j < pt->selfObj->pktVectorNum; ++j)
+                cost += pt->selfObj->pktVector[j]->pbuf.size();
+
+            pt->avg_cost = (pt->avg_cost * 7 + cost) / 8;
+
+            chargeBudget(*origpkt.ttlfocus, cost);
+        }
+
+        for (uint8_t j = 0; j < pt->selfObj->pktVectorNum; ++j)
         {
-            Packet &injpkt = **hack_it;
+            Packet &injpkt = *pt->selfObj->pktVector[j];
             /*
              * we trust in the external developer, but it's required a
              * simple safety check by sniffjoke :)
@@ -608,7 +996,7 @@ bool TCPTrack::injectHack(Packet &origpkt)
                 p_queue.insertAfter(injpkt, origpkt);
                 break;
             case ANY_POSITION:
-                if (random() % 2)
+                if (sj_random() % 2)
                     p_queue.insertBefore(injpkt, origpkt);
                 else
                     p_queue.insertAfter(injpkt, origpkt);
@@ -654,21 +1042,22 @@ bool TCPTrack::injectHack(Packet &origpkt)
  */
 bool TCPTrack::lastPktFix(Packet &pkt)
 {
-    TTLFocus &ttlfocus = ttlfocus_map->get(pkt);
+    /* the packets built from scratch by a plugin don't carry the handle */
+    TTLFocus &ttlfocus = (pkt.ttlfocus != NULL) ? *pkt.ttlfocus : ttlfocus_map->get(pkt);
 
     if (ttlfocus.status == TTL_KNOWN)
     {
         /* WHAT VALUE OF TTL GIVE TO THE PACKET ? */
         if (pkt.wtf == PRESCRIPTION)
         {
-            pkt.ip->ttl = ttlfocus.ttl_estimate - (1 + (random() % 2)); /* [-1, -2], 2 values */
+            pkt.ip->ttl = ttlfocus.ttl_estimate - (1 + (sj_random() % 2)); /* [-1, -2], 2 values */
         }
         else
         {
             /* MISTIFICATION FOR WTF != PRESCRIPTION */
             /* apply mystification if PRESCRIPTION is globally enabled */
             if (ISSET_TTL(plugin_pool->enabledScrambles()))
-                pkt.ip->ttl = ttlfocus.ttl_estimate + (random() % 4); /* [+0, +3], 4 values */
+                pkt.ip->ttl = ttlfocus.ttl_estimate + (sj_random() % 4); /* [+0, +3], 4 values */
         }
     }
     else
@@ -697,7 +1086,7 @@ bool TCPTrack::lastPktFix(Packet &pkt)
             /* MISTIFICATION APPLY ON DOWNGRADE, RANDOMIZING A BIT THE ORIGINAL TTL VALUE */
             /* apply mystification if PRESCRIPTION is globally enabled */
             if (ISSET_TTL(plugin_pool->enabledScrambles()))
-                pkt.ip->ttl += (random() % 20) - 10; /* [-10, +10 ], 20 mystification values */
+                pkt.ip->ttl += (sj_random() % 20) - 10; /* [-10, +10 ], 20 mystification values */
         }
     }
 
@@ -844,96 +1233,181 @@ drop_packet:
  */
 void TCPTrack::handleYoungPackets(void)
 {
+    Packet *batch[PKTBATCH_SIZE];
+    uint8_t count = 0;
     Packet *pkt = NULL;
 
-    for (p_queue.select(YOUNG); ((pkt = p_queue.get()) != NULL);)
+    /* the NETWORK packets are analyzed in batches, see handleIncomingBatch() */
+    for (p_queue.select(YOUNG); ((pkt = p_queue.getSource(NETWORK)) != NULL);)
     {
-        switch (pkt->source)
+        batch[count++] = pkt;
+
+        if (count == PKTBATCH_SIZE)
         {
-        case NETWORK:
+            handleIncomingBatch(batch, count);
+            count = 0;
+        }
+    }
 
-            /*
-             * every incoming packet, triggered or not by our TTLBRUTEFORCE routine
-             * will have useful informations for TTL stats.
-             */
-            if (extractTTLinfo(*pkt))
-            {
-                pkt->SELFLOG("removal requested by extractTTLinfo");
-                p_queue.drop(*pkt);
-                continue;
-            }
+    if (count)
+        handleIncomingBatch(batch, count);
 
-            if (packet_filter.match(*pkt))
-            {
-                pkt->SELFLOG("removal requested by PacketFilter");
-                p_queue.drop(*pkt);
-                continue;
-            }
+    for (p_queue.select(YOUNG); ((pkt = p_queue.get()) != NULL);)
+        classifyPacket(*pkt);
+}
 
-            /* here we notify each plugin of the arrival of a packet */
-            if (notifyIncoming(*pkt))
-            {
-                pkt->SELFLOG("removal requested by notifyIncoming");
-                p_queue.drop(*pkt);
-                continue;
-            }
+/*
+ * the NETWORK packets of YOUNG go through every stage together, stage by
+ * stage, instead of one packet through all the stages: the code and the
+ * data of a stage are used for the whole batch, and the plugins receive
+ * one mangleIncomingBatch() call for every batch. the headers of the next
+ * packet are prefetched while the TTL informations of one are extracted.
+ *
+ * the result is the same of classifyPacket() on every packet.
+ */
+void TCPTrack::handleIncomingBatch(Packet * const *batch, uint8_t count)
+{
+    Packet *alive[PKTBATCH_SIZE];
+    bool remove[PKTBATCH_SIZE];
+    uint8_t alive_count = 0;
 
-            /* packets received from network does not need to be hacked */
-            p_queue.insert(*pkt, SEND);
-            break;
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        if (i + 1 < count)
+            __builtin_prefetch(batch[i + 1]->ip);
 
-        case TUNNEL:
+        /*
+         * every incoming packet, triggered or not by our TTLBRUTEFORCE routine
+         * will have useful informations for TTL stats.
+         */
+        if (extractTTLinfo(*batch[i]))
+        {
+            batch[i]->SELFLOG("removal requested by extractTTLinfo");
+            p_queue.drop(*batch[i]);
+            continue;
+        }
 
-            /* SniffJoke ATM does apply to TCP/UDP traffic only */
-            if (pkt->proto & (TCP | UDP))
-            {
-                ++(sessiontrack_map->get(*pkt).packet_number);
+        alive[alive_count++] = batch[i];
+    }
 
-                /*
-                 * ATM we can put TCP only in KEEP status because
-                 * due to the actual ttl bruteforce implementation a
-                 * pure UDP flaw could go in starvation.
-                 */
-                if (pkt->proto == TCP && ttlfocus_map->get(*pkt).status == TTL_BRUTEFORCE)
-                {
-                    p_queue.insert(*pkt, KEEP);
-                }
-                else
-                {
-                    p_queue.insert(*pkt, HACK);
-                }
-            }
-            else
-            {
-                p_queue.insert(*pkt, SEND);
-            }
-            break;
+    count = alive_count;
+    alive_count = 0;
+
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        if (packet_filter.match(*alive[i]))
+        {
+            alive[i]->SELFLOG("removal requested by PacketFilter");
+            p_queue.drop(*alive[i]);
+            continue;
+        }
 
-        default:
+        alive[alive_count] = alive[i];
+        remove[alive_count++] = false;
+    }
+
+    /* here we notify each plugin of the arrival of the packets */
+    notifyIncomingBatch(alive, alive_count, remove);
 
-            RUNTIME_EXCEPTION("FATAL CODE [CYN1C]: please send a notification to the developers (%u)", pkt->source);
+    for (uint8_t i = 0; i < alive_count; ++i)
+    {
+        if (remove[i])
+        {
+            alive[i]->SELFLOG("removal requested by notifyIncoming");
+            p_queue.drop(*alive[i]);
+            continue;
         }
+
+        /* packets received from network does not need to be hacked */
+        p_queue.insert(*alive[i], SEND);
     }
 }
 
-/*
- * here we analyze KEEP queue
- *
- * we handle only:
- *
- *   TUNNEL packets:
- *     - we analyze tcp/udp packets to see if can marked sendable or if they
- *       need to be hold in status KEEP waiting for some conditions.
- *
- *   any other pkt->source does scatter a fatal exception.
- */
-void TCPTrack::handleKeepPackets(void)
+/* a YOUNG packet is moved in SEND, KEEP or HACK, or dropped */
+void TCPTrack::classifyPacket(Packet &pkt)
 {
-    Packet *pkt = NULL;
-    for (p_queue.select(KEEP); ((pkt = p_queue.getSource(TUNNEL)) != NULL);)
+    switch (pkt.source)
     {
-        if (ttlfocus_map->get(*pkt).status != TTL_BRUTEFORCE)
-            p_queue.insert(*pkt, HACK);
+    case NETWORK:
+
+        /*
+         * every incoming packet, triggered or not by our TTLBRUTEFORCE routine
+         * will have useful informations for TTL stats.
+         */
+        if (extractTTLinfo(pkt))
+        {
+            pkt.SELFLOG("removal requested by extractTTLinfo");
+            p_queue.drop(pkt);
+            return;
+        }
+
+        if (packet_filter.match(pkt))
+        {
+            pkt.SELFLOG("removal requested by PacketFilter");
+            p_queue.drop(pkt);
+            return;
+        }
+
+        /* here we notify each plugin of the arrival of a packet */
+        if (notifyIncoming(pkt))
+        {
+            pkt.SELFLOG("removal requested by notifyIncoming");
+            p_queue.drop(pkt);
+            return;
+        }
+
+        /* packets received from network does not need to be hacked */
+        p_queue.insert(pkt, SEND);
+        break;
+
+    case TUNNEL:
+
+        /* SniffJoke ATM does apply to TCP/UDP traffic only */
+        if (pkt.proto & (TCP | UDP))
+        {
+            /* the flow is resolved here once: the packet and its copies carry it */
+            pkt.attachFlow(&sessiontrack_map->get(pkt), &ttlfocus_map->get(pkt));
+
+            ++(pkt.sessiontrack->packet_number);
+            pkt.sessiontrack->bytes += pkt.pbuf.size();
+
+            if (userconf->runcfg.budget_percent)
+                creditBudget(*pkt.ttlfocus, pkt.pbuf.size());
+
+            /*
+             * ATM we can put TCP only in KEEP status because
+             * due to the actual ttl bruteforce implementation a
+             * pure UDP flaw could go in starvation.
+             *
+             * the kept packet is appended to the wait list of its
+             * destination and released by releaseKeepPackets().
+             *
+             * in optimistic mode nothing is held: the bruteforce runs in
+             * parallel and discernAvailScramble() offers the TTL scramble
+             * only when the status becomes KNOWN.
+             */
+            TTLFocus * const ttlfocus = (pkt.proto == TCP) ? pkt.ttlfocus : NULL;
+            if (ttlfocus != NULL && ttlfocus->status == TTL_BRUTEFORCE && !ttlfocus->hold_expired
+                    && !userconf->runcfg.optimistic)
+            {
+                pkt.keep_timestamp = sj_clock_us;
+                p_queue.insert(pkt, KEEP);
+                ttlfocus->keep_pkts.push_back(&pkt);
+            }
+            else
+            {
+                p_queue.insert(pkt, HACK);
+            }
+        }
+        else
+        {
+            p_queue.insert(pkt, SEND);
+        }
+        break;
+
+    default:
+
+        RUNTIME_EXCEPTION("FATAL CODE [CYN1C]: please send a notification to the developers (%u)", pkt.source);
     }
 }
 
@@ -985,88 +1459,253 @@ void TCPTrack::handleHackPackets(void)
     }
 
     for (p_queue.select(HACK); ((pkt = p_queue.get()) != NULL);)
+        schedulePacket(*pkt);
+}
+
+/*
+ * the packets with a send_gap_us (set by the plugins, or by the core for
+ * the injected packets when the pacing option is used) are held in the
+ * TimerWheel instead of the SEND queue.
+ *
+ * the gap is counted from the time of the previous packet scheduled for
+ * the same destination (TTLFocus::pacing_last), and every packet of a
+ * destination with paced packets pending is scheduled too: the order of
+ * the originals and of the ANTICIPATION/POSTICIPATION packets is never
+ * changed.
+ */
+void TCPTrack::schedulePacket(Packet &pkt)
+{
+    if (pkt.source == PLUGIN && !pkt.send_gap_us && userconf->runcfg.pacing_us)
+        pkt.send_gap_us = (sj_random() % userconf->runcfg.pacing_us) + 1;
+
+    if ((!pkt.send_gap_us && pacing_wheel.empty()) || pkt.ttlfocus == NULL)
+    {
+        p_queue.insert(pkt, SEND);
+        return;
+    }
+
+    /* in run-to-completion mode no queue sweep has advanced the wheel to this packet */
+    if (userconf->runcfg.run_to_completion)
+        releasePacedPackets();
+
+    /* the wheel is bounded with SEND: the injected packets are not paced over the limits */
+    if ((pkt.source == PLUGIN || userconf->runcfg.drop_tail) &&
+        overQueueLimits(p_queue.packets(SEND) + pacing_wheel.packets() + 1,
+                        p_queue.bytes(SEND) + pacing_wheel.bytes() + pkt.pbuf.size(), 100))
+    {
+        pkt.SELFLOG("dropped for the queue limits");
+        p_queue.drop(pkt);
+        return;
+    }
+
+    uint64_t &last = pkt.ttlfocus->pacing_last;
+    const uint64_t when = ((last > pacing_now) ? last : pacing_now) + pkt.send_gap_us;
+
+    last = when;
+
+    if (when <= pacing_now)
+    {
+        p_queue.insert(pkt, SEND);
+        return;
+    }
+
+    pkt.SELFLOG("paced of %u us", (uint32_t) (when - pacing_now));
+
+    p_queue.extract(pkt);
+    pacing_wheel.schedule(pkt, when);
+}
+
+/* the expired paced packets are moved in SEND before the packets of this cycle */
+void TCPTrack::releasePacedPackets(void)
+{
+    Packet *pkt;
+
+    pacing_now = monotonicClockUs();
+    pacing_wheel.advance(pacing_now);
+
+    while ((pkt = pacing_wheel.get()) != NULL)
         p_queue.insert(*pkt, SEND);
 }
 
+/* microseconds before a paced packet has to be released, -1 if none is waiting */
+int64_t TCPTrack::pacingDelayUs(void) const
+{
+    if (pacing_wheel.empty())
+        return -1;
+
+    const uint64_t deadline = pacing_wheel.nextDeadline();
+    const uint64_t now = monotonicClockUs();
+
+    return (deadline > now) ? (int64_t) (deadline - now) : 0;
+}
+
+/* true when the packets and bytes are over the given percent of the queue limits */
+bool TCPTrack::overQueueLimits(uint32_t pkts, uint32_t bytes, uint8_t percent) const
+{
+    const uint64_t max_pkts = userconf->runcfg.queue_limit;
+    const uint64_t max_bytes = (uint64_t) userconf->runcfg.queue_limit_kb * 1024;
+
+    return (max_pkts && (uint64_t) pkts * 100 > max_pkts * percent) ||
+           (max_bytes && (uint64_t) bytes * 100 > max_bytes * percent);
+}
+
+/*
+ * every queue is kept under the queue-limit and queue-limit-kb values
+ * dropping, unless drop-tail is configured, the injected packets first:
+ * losing one of them costs only a missed hack, while a real packet costs
+ * a retransmission. the KEEP packets are removed from their TTLFocus too.
+ * the paced packets are counted with SEND, where the drops are taken:
+ * the wheel keeps the order of a destination and is never cut.
+ */
+void TCPTrack::enforceQueueLimits(void)
+{
+    if (!userconf->runcfg.queue_limit && !userconf->runcfg.queue_limit_kb)
+        return;
+
+    uint32_t injected = 0, real = 0;
+
+    for (uint8_t q = FIRST_QUEUE; q <= LAST_QUEUE; q <<= 1)
+    {
+        const queue_t queue = (queue_t) q;
+        const uint32_t paced_pkts = (queue == SEND) ? pacing_wheel.packets() : 0;
+        const uint32_t paced_bytes = (queue == SEND) ? pacing_wheel.bytes() : 0;
+
+        while (p_queue.packets(queue) &&
+               overQueueLimits(p_queue.packets(queue) + paced_pkts, p_queue.bytes(queue) + paced_bytes, 100))
+        {
+            Packet * const pkt = p_queue.dropCandidate(queue, !userconf->runcfg.drop_tail);
+
+            if (queue == KEEP)
+            {
+                vector<Packet *> &keep_pkts = pkt->ttlfocus->keep_pkts;
+                keep_pkts.erase(find(keep_pkts.begin(), keep_pkts.end(), pkt));
+            }
+
+            if (pkt->source == PLUGIN)
+                ++injected;
+            else
+                ++real;
+
+            pkt->SELFLOG("dropped for the queue limits");
+            p_queue.drop(*pkt);
+        }
+    }
+
+    if (injected || real)
+        LOG_VERBOSE("queue limits reached: dropped %u injected and %u real packets", injected, real);
+}
+
+/*
+ * the tunnel is not read while too many packets are waiting to be sent in
+ * the network, the paced ones included. the bytes of SEND are of both the
+ * directions: over the byte limit the tunnel is paused a bit earlier.
+ */
+bool TCPTrack::tunnelBackpressure(void) const
+{
+    return overQueueLimits(p_queue.sendPending(TUNNEL) + pacing_wheel.packets(),
+                           p_queue.bytes(SEND) + pacing_wheel.bytes(), SEND_BACKPRESSURE_PERCENT);
+}
+
 /* the packet is added in the packet queue here to be analyzed in a second time */
 void TCPTrack::writepacket(source_t source, const unsigned char *buff, int nbyte)
 {
+    /* anomalous/malformed packets are flushed bypassing the queue */
+    const pktcheck_t check = Packet::validate(buff, nbyte);
+    if (check != PKTCHECK_OK)
+    {
+        ++Packet::rejectedCounter[check];
+        LOG_DEBUG("malformed orig pkt dropped: %s", Packet::getCheckStr(check));
+        return;
+    }
+
+    Packet *pkt;
+
     try
     {
-        Packet * const pkt = new Packet(buff, nbyte);
-        pkt->source = source;
-        pkt->wtf = INNOCENT;
-        pkt->choosableScramble = INNOCENT; /* on innocent pkts this variable is meaningless */
+        pkt = new Packet(buff, nbyte);
+    }
+    catch (exception &e)
+    {
+        /* validate() mirrors updatePacketMetadata, reaching here is a bug */
+        LOG_ALL("orig pkt dropped after validation: %s", e.what());
+        return;
+    }
 
-        /* Sniffjoke does handle only TCP, UDP and ICMP */
-        if (userconf->runcfg.active && (pkt->proto & mangled_proto_mask))
+    pkt->source = source;
+    pkt->wtf = INNOCENT;
+    pkt->choosableScramble = INNOCENT; /* on innocent pkts this variable is meaningless */
+
+    /* Sniffjoke does handle only TCP, UDP and ICMP */
+    if (userconf->runcfg.active && (pkt->proto & mangled_proto_mask))
+    {
+        if (userconf->runcfg.use_blacklist)
         {
-            if (userconf->runcfg.use_blacklist)
+            if (userconf->runcfg.blacklist->isPresent(pkt->ip->daddr) ||
+                    userconf->runcfg.blacklist->isPresent(pkt->ip->saddr))
             {
-                if (userconf->runcfg.blacklist->isPresent(pkt->ip->daddr) ||
-                        userconf->runcfg.blacklist->isPresent(pkt->ip->saddr))
-                {
-                    p_queue.insert(*pkt, SEND);
-                    return;
-                }
+                p_queue.insert(*pkt, SEND);
+                return;
             }
-            else if (userconf->runcfg.use_whitelist)
+        }
+        else if (userconf->runcfg.use_whitelist)
+        {
+            if (!userconf->runcfg.whitelist->isPresent(pkt->ip->daddr) &&
+                    !userconf->runcfg.whitelist->isPresent(pkt->ip->saddr))
             {
-                if (!userconf->runcfg.whitelist->isPresent(pkt->ip->daddr) &&
-                        !userconf->runcfg.whitelist->isPresent(pkt->ip->saddr))
-                {
-                    p_queue.insert(*pkt, SEND);
-                    return;
-                }
+                p_queue.insert(*pkt, SEND);
+                return;
             }
-
-            p_queue.insert(*pkt, YOUNG);
-            return;
         }
 
-        p_queue.insert(*pkt, SEND);
+        p_queue.insert(*pkt, YOUNG);
 
+        if (userconf->runcfg.run_to_completion)
+            processPacket(*pkt);
+
+        return;
     }
-    catch (exception &e)
-    {
-        /* anomalous/malformed packets are flushed bypassing the queue */
-        LOG_ALL("malformed orig pkt dropped: %s", e.what());
-    }
+
+    p_queue.insert(*pkt, SEND);
 }
 
 /*
- * this functions returns a packet from the SEND queue given a specific source
+ * run-to-completion mode: the packet just read goes through the
+ * classification, the TTL extraction, the hacks and lastPktFix in this
+ * call, while it is still hot in cache. the HACK queue contains only the
+ * packet, its injected packets and the KEEP packets released by its
+ * TTL informations, so handleHackPackets() does not walk anything else.
+ * only the KEEP packets wait for analyzePacketQueue().
  */
-Packet * TCPTrack::readpacket(source_t destsource)
+void TCPTrack::processPacket(Packet &pkt)
 {
-    uint8_t mask;
-    if (destsource == NETWORK)
-        mask = NETWORK;
-    else
-        mask = TUNNEL | PLUGIN | TRACEROUTE;
+    classifyPacket(pkt);
 
-    Packet *pkt = NULL;
-    for (p_queue.select(SEND); ((pkt = p_queue.get()) != NULL);)
-    {
-        if (pkt->source & mask)
-        {
-            p_queue.extract(*pkt);
-            return pkt;
-        }
-    }
+    if (p_queue.packets(HACK))
+        handleHackPackets();
+}
 
-    return NULL;
+/*
+ * this functions returns a packet from the SEND queue given a specific source
+ */
+Packet * TCPTrack::readpacket(source_t destsource)
+{
+    return p_queue.extractSend(destsource);
 }
 
 void TCPTrack::analyzePacketQueue(void)
 {
+    random_reseed_check();
+
+    releasePacedPackets();
+
     /* if all queues are empy we have nothing to do */
     if (!p_queue.size())
         goto bypass_queue_analysis;
 
     handleYoungPackets();
-    handleKeepPackets();
+    expireKeepPackets();
     handleHackPackets();
+    enforceQueueLimits();
 
 bypass_queue_analysis:
 
@@ -1078,7 +1717,7 @@ bypass_queue_analysis:
      * limits are passed, will delete the oldest records.
      * This is completely safe because send packets are just HACKed and there
      * is no problem if we does not schedule a ttlprobe for a cycle;
-     * KEEP packets will scatter a new ttlfocus at the next.
+     * the ttlfocus of the KEEP packets are never removed.
      */
 
     sessiontrack_map->manage();
@@ -28,14 +28,36 @@
 #include "PortConf.h"
 #include "Packet.h"
 #include "PacketQueue.h"
+#include "TimerWheel.h"
 #include "PacketFilter.h"
 #include "SessionTrack.h"
 #include "TTLFocus.h"
 #include "HDRoptions.h"
 #include "PluginPool.h"
 
+/* buckets of the KEEP hold time histogram, the last one counts the longer holds */
+#define HOLDSTAT_BUCKETS    12
+
+/*
+ * the aggressivity percentage depends on the packet number only up to 150
+ * (the peeks look at n+-2 and the thresholds end at 120), then on its
+ * modulo 30; and on the clock only by its modulo 20.
+ */
+#define AGG_PKTCLASS_EXACT  150
+#define AGG_PKTCLASSES      (AGG_PKTCLASS_EXACT + 30)
+#define AGG_PHASES          20
+
+struct aggressivityTable
+{
+    uint16_t frequency;
+    uint8_t percentage[AGG_PKTCLASSES][AGG_PHASES];
+};
+
 class TCPTrack
 {
+    /* InjectHackTest.cc drives injectHack() directly */
+    friend class InjectHackTest;
+
 private:
 
     uint8_t mangled_proto_mask;
@@ -43,23 +65,64 @@ private:
     PacketFilter packet_filter;
     PacketQueue p_queue;
 
-    uint32_t derivePercentage(uint32_t, uint16_t);
-    bool percentage(uint32_t, uint16_t, uint16_t);
-    uint16_t getUserFrequency(const Packet &);
+    uint32_t hold_histogram[HOLDSTAT_BUCKETS];
+
+    /* packets paced by send_gap_us, the last time scheduled is in the TTLFocus */
+    TimerWheel pacing_wheel;
+    uint64_t pacing_now;
+
+    /* one table for every aggressivity present in the port configuration */
+    vector<aggressivityTable> agg_tables;
+    vector<uint16_t> agg_tcp_id;
+    uint16_t agg_udp_always_id;
+    uint16_t agg_udp_common_id;
+
+    /* incremented when the tables are rebuilt: the hack plans older are recomputed */
+    uint32_t plan_epoch;
+
+    /* the global injection budget, refilled at budget_kbps */
+    uint32_t budget_tokens;
+    uint64_t budget_refill_us;
+    uint32_t budget_injected;
+    uint32_t budget_refused;
+
+    static uint32_t derivePercentage(uint32_t, uint8_t, uint16_t);
+    uint16_t addAggressivity(uint16_t);
+    uint16_t aggressivityId(const Packet &) const;
+    uint8_t aggressivityOf(uint16_t, uint32_t) const;
+    static uint8_t bulkDecay(const SessionTrack &, uint8_t);
+    bool percentage(uint8_t);
     uint8_t discernAvailScramble(const Packet &);
+    void updatePlan(SessionTrack &, const Packet &);
 
+    void creditBudget(TTLFocus &, uint32_t);
+    bool affordBudget(TTLFocus &, uint32_t);
+    void chargeBudget(TTLFocus &, uint32_t);
+    static void sortByCost(PluginTrack **, uint8_t);
+
+    void releaseKeepPackets(TTLFocus &);
+    void expireKeepPackets(void);
     void injectTTLProbe(TTLFocus &);
     void execTTLBruteforces(void);
     bool extractTTLinfo(const Packet &);
 
+    void notifyIncomingBatch(Packet * const *, uint8_t, bool *);
     bool notifyIncoming(Packet &);
     bool injectHack(Packet &);
     bool lastPktFix(Packet &);
 
     void handleYoungPackets(void);
-    void handleKeepPackets(void);
+    void handleIncomingBatch(Packet * const *, uint8_t);
+    void classifyPacket(Packet &);
+    void processPacket(Packet &);
     void handleHackPackets(void);
 
+    void releasePacedPackets(void);
+    void schedulePacket(Packet &);
+
+    bool overQueueLimits(uint32_t, uint32_t, uint8_t) const;
+    void enforceQueueLimits(void);
+
 public:
 
     TCPTrack(void);
@@ -68,6 +131,12 @@ public:
     void writepacket(source_t, const unsigned char *, int);
     Packet* readpacket(source_t);
     void analyzePacketQueue(void);
+    void dumpHoldHistogram(struct hold_record *) const;
+    void dumpBudget(struct budget_record *) const;
+    bool tunnelBackpressure(void) const;
+    void buildAggressivityTable(void);
+
+    int64_t pacingDelayUs(void) const;
 };
 
 #endif /* SJ_TCPTRACK_H */
@@ -27,13 +27,19 @@ access_timestamp(sj_clock),
 next_probe_time(sj_clock),
 probe_timeout(0),
 status(TTL_BRUTEFORCE),
-rand_key(random()),
+rand_key(sj_random()),
 puppet_port(0),
 sent_probe(0),
 received_probe(0),
 daddr(pkt.ip->daddr),
 ttl_estimate(0xff),
-ttl_synack(0)
+ttl_synack(0),
+hold_expired(false),
+budget_tokens(BUDGET_DEST_BURST),
+budget_injected(0),
+budget_refused(0),
+pacing_last(0),
+refs(0)
 {
     struct iphdr *newip = (struct iphdr *) probe_dummy;
     struct tcphdr *newtcp = (struct tcphdr *) (probe_dummy + sizeof (struct iphdr));
@@ -65,13 +71,19 @@ TTLFocus::TTLFocus(const struct ttlfocus_cache_record& cpy) :
 access_timestamp(cpy.access_timestamp),
 next_probe_time(sj_clock),
 status(TTL_KNOWN),
-rand_key(random()),
+rand_key(sj_random()),
 puppet_port(0),
 sent_probe(0),
 received_probe(0),
 daddr(cpy.daddr),
 ttl_estimate(cpy.ttl_estimate),
-ttl_synack(cpy.ttl_synack)
+ttl_synack(cpy.ttl_synack),
+hold_expired(false),
+budget_tokens(BUDGET_DEST_BURST),
+budget_injected(0),
+budget_refused(0),
+pacing_last(0),
+refs(0)
 {
     memcpy(probe_dummy, cpy.probe_dummy, 40);
 
@@ -89,7 +101,7 @@ uint16_t TTLFocus::selectPuppetPort(uint16_t realport)
 
     do
     {
-        puppet_port = (random() % (32767 - 1024)) + 1024;
+        puppet_port = (sj_random() % (32767 - 1024)) + 1024;
     }
 
     while ((puppet_port >> 4) == (realport >> 4));
@@ -182,7 +194,7 @@ void TTLFocusMap::manage(void)
         manage_timeout = sj_clock; /* update the next manage timeout */
         for (TTLFocusMap::iterator it = begin(); it != end();)
         {
-            if ((*it).second->access_timestamp + TTLFOCUS_EXPIRYTIME < sj_clock)
+            if ((*it).second->access_timestamp + TTLFOCUS_EXPIRYTIME < sj_clock && !(*it).second->refs)
                 erase(it++);
             else
                 ++it;
@@ -220,9 +232,14 @@ void TTLFocusMap::manage(void)
         }
         while (++index != TTLFOCUSMAP_MEMORY_THRESHOLD / 2);
 
+        /* the destinations referred by the packets in the queues (KEEP too) are kept anyway */
         do
-            delete tmp[index];
-
+        {
+            if (!tmp[index]->refs)
+                delete tmp[index];
+            else
+                insert(pair<uint32_t, TTLFocus*>((tmp[index])->daddr, tmp[index]));
+        }
         while (++index != map_size);
 
         delete[] tmp;
@@ -71,6 +71,21 @@ public:
                                       the packet size is always 40 bytes long,
                                       (sizeof(struct iphdr) + sizeof(struct tcphdr)) */
 
+    vector<Packet *> keep_pkts; /* packets held in the KEEP queue waiting the end of
+                                   the ttl bruteforce; the ttlfocus is never expired
+                                   while this list is not empty */
+    bool hold_expired; /* the max hold time is passed in the current bruteforce:
+                          the packets are not held anymore */
+
+    uint32_t budget_tokens; /* bytes that can be injected now, see TCPTrack::affordBudget() */
+    uint32_t budget_injected; /* bytes injected toward the destination */
+    uint32_t budget_refused; /* hacks not applied over the budget */
+
+    uint64_t pacing_last; /* last send time scheduled toward the destination, see TCPTrack::schedulePacket() */
+
+    uint32_t refs; /* packets carrying this destination (see Packet::attachFlow),
+                      the kept ones included: never expired while not 0 */
+
     TTLFocus(void);
     TTLFocus(const Packet &pkt);
     TTLFocus(const struct ttlfocus_cache_record &);
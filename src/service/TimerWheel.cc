@@ -0,0 +1,177 @@
+/*
+ *   SniffJoke is a software able to confuse the Internet traffic analysis,
+ *   developed with the aim to improve digital privacy in communications and
+ *   to show and test some securiy weakness in traffic analysis software.
+ *   
+ *   Copyright (C) 2010, 2011 vecna <vecna@delirandom.net>
+ *                            evilaliv3 <giovanni.pellerano@evilaliv3.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TimerWheel.h"
+
+TimerWheel::TimerWheel(void) :
+cur_tick(0),
+pkt_count(0),
+pkt_bytes(0)
+{
+    LOG_DEBUG("");
+
+    memset(level0, 0, sizeof (level0));
+    memset(level1, 0, sizeof (level1));
+    memset(&expired, 0, sizeof (expired));
+}
+
+TimerWheel::~TimerWheel(void)
+{
+    LOG_DEBUG("");
+
+    Packet *pkt;
+
+    /* all the packets are moved in the expired list and deleted */
+    if (pkt_count)
+        advance((cur_tick + (TIMERWHEEL_LEVEL_SLOTS << TIMERWHEEL_LEVEL_BITS)) << TIMERWHEEL_TICK_SHIFT);
+
+    while ((pkt = get()) != NULL)
+        delete pkt;
+}
+
+void TimerWheel::append(struct wheelSlot &slot, Packet &pkt)
+{
+    pkt.next = NULL;
+
+    if (slot.head == NULL)
+        slot.head = &pkt;
+    else
+        slot.tail->next = &pkt;
+
+    slot.tail = &pkt;
+}
+
+void TimerWheel::place(Packet &pkt, uint64_t tick)
+{
+    if ((tick >> TIMERWHEEL_LEVEL_BITS) == (cur_tick >> TIMERWHEEL_LEVEL_BITS))
+        append(level0[tick & TIMERWHEEL_LEVEL_MASK], pkt);
+    else
+        append(level1[(tick >> TIMERWHEEL_LEVEL_BITS) & TIMERWHEEL_LEVEL_MASK], pkt);
+}
+
+void TimerWheel::schedule(Packet &pkt, uint64_t when)
+{
+    /* rounded up: a packet never leaves before its time */
+    uint64_t tick = (when + (1 << TIMERWHEEL_TICK_SHIFT) - 1) >> TIMERWHEEL_TICK_SHIFT;
+
+    /* the last tick reachable is in the last rotation of the second level */
+    const uint64_t last_tick = ((cur_tick >> TIMERWHEEL_LEVEL_BITS) + TIMERWHEEL_LEVEL_MASK) << TIMERWHEEL_LEVEL_BITS;
+
+    if (tick < cur_tick)
+        tick = cur_tick;
+    else if (tick > last_tick)
+        tick = last_tick;
+
+    pkt.send_not_before = tick << TIMERWHEEL_TICK_SHIFT;
+
+    ++pkt_count;
+    pkt_bytes += pkt.pbuf.size();
+    place(pkt, tick);
+}
+
+/* the second level slot of the rotation just entered by cur_tick is distributed */
+void TimerWheel::cascade(void)
+{
+    struct wheelSlot &slot = level1[(cur_tick >> TIMERWHEEL_LEVEL_BITS) & TIMERWHEEL_LEVEL_MASK];
+    Packet *pkt = slot.head;
+
+    slot.head = slot.tail = NULL;
+
+    while (pkt != NULL)
+    {
+        Packet * const next = pkt->next;
+        place(*pkt, pkt->send_not_before >> TIMERWHEEL_TICK_SHIFT);
+        pkt = next;
+    }
+}
+
+void TimerWheel::advance(uint64_t now)
+{
+    const uint64_t now_tick = now >> TIMERWHEEL_TICK_SHIFT;
+
+    while (pkt_count && cur_tick <= now_tick)
+    {
+        struct wheelSlot &slot = level0[cur_tick & TIMERWHEEL_LEVEL_MASK];
+        while (slot.head != NULL)
+        {
+            Packet * const pkt = slot.head;
+            slot.head = pkt->next;
+
+            append(expired, *pkt);
+            --pkt_count;
+            pkt_bytes -= pkt->pbuf.size();
+        }
+        slot.tail = NULL;
+
+        /* a schedule() in the new rotation must find the older packets already placed */
+        if (!(++cur_tick & TIMERWHEEL_LEVEL_MASK))
+            cascade();
+    }
+
+    /* an empty wheel restarts from the present, its second level is empty */
+    if (!pkt_count && cur_tick <= now_tick)
+        cur_tick = now_tick + 1;
+}
+
+/*
+ * the time from which advance() has some packet to expire: 0 when they
+ * are already expired, the beginning of the rotation for the packets
+ * still in the second level. not meaningful on an empty() wheel.
+ */
+uint64_t TimerWheel::nextDeadline(void) const
+{
+    if (expired.head != NULL || !pkt_count)
+        return 0;
+
+    const uint64_t rotation = cur_tick >> TIMERWHEEL_LEVEL_BITS;
+
+    for (uint64_t tick = cur_tick; tick < ((rotation + 1) << TIMERWHEEL_LEVEL_BITS); ++tick)
+    {
+        if (level0[tick & TIMERWHEEL_LEVEL_MASK].head != NULL)
+            return tick << TIMERWHEEL_TICK_SHIFT;
+    }
+
+    for (uint64_t r = rotation + 1; r < rotation + TIMERWHEEL_LEVEL_SLOTS; ++r)
+    {
+        if (level1[r & TIMERWHEEL_LEVEL_MASK].head != NULL)
+            return (r << TIMERWHEEL_LEVEL_BITS) << TIMERWHEEL_TICK_SHIFT;
+    }
+
+    return 0;
+}
+
+/* returns the expired packets in order, with the links reset for PacketQueue */
+Packet* TimerWheel::get(void)
+{
+    Packet * const pkt = expired.head;
+
+    if (pkt != NULL)
+    {
+        expired.head = pkt->next;
+        if (expired.head == NULL)
+            expired.tail = NULL;
+
+        pkt->next = NULL;
+    }
+
+    return pkt;
+}
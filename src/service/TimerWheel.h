@@ -0,0 +1,95 @@
+/*
+ *   SniffJoke is a software able to confuse the Internet traffic analysis,
+ *   developed with the aim to improve digital privacy in communications and
+ *   to show and test some securiy weakness in traffic analysis software.
+ *   
+ *   Copyright (C) 2010, 2011 vecna <vecna@delirandom.net>
+ *                            evilaliv3 <giovanni.pellerano@evilaliv3.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SJ_TIMERWHEEL_H
+#define SJ_TIMERWHEEL_H
+
+#include "Utils.h"
+#include "Packet.h"
+
+/*
+ * a two level hierarchical timer wheel holding the packets to be sent at
+ * a given time (Packet::send_not_before, in microseconds of sj_clock_us).
+ *
+ * the first level has a slot for every tick of the current rotation, the
+ * second level a slot for every rotation of the first: a packet scheduled
+ * in a following rotation is moved in the first level as soon as cur_tick
+ * enters its rotation, before any other packet can be scheduled in it.
+ * the packets are linked by Packet::next and every slot is a FIFO, so the
+ * packets scheduled for the same tick exit in insertion order.
+ * the times over the range of the second level are clamped to its end.
+ *
+ * advance() must be called with the present time before every schedule().
+ */
+#define TIMERWHEEL_TICK_SHIFT       6   /* 64 microseconds */
+#define TIMERWHEEL_LEVEL_BITS       8
+#define TIMERWHEEL_LEVEL_SLOTS      (1 << TIMERWHEEL_LEVEL_BITS)
+#define TIMERWHEEL_LEVEL_MASK       (TIMERWHEEL_LEVEL_SLOTS - 1)
+
+class TimerWheel
+{
+private:
+
+    struct wheelSlot
+    {
+        Packet *head;
+        Packet *tail;
+    };
+
+    uint64_t cur_tick; /* the first tick not yet expired */
+    uint32_t pkt_count; /* packets in the two levels */
+    uint32_t pkt_bytes; /* and their bytes */
+
+    struct wheelSlot level0[TIMERWHEEL_LEVEL_SLOTS];
+    struct wheelSlot level1[TIMERWHEEL_LEVEL_SLOTS];
+    struct wheelSlot expired;
+
+    static void append(struct wheelSlot &, Packet &);
+    void place(Packet &, uint64_t);
+    void cascade(void);
+
+public:
+    TimerWheel(void);
+    ~TimerWheel(void);
+    void schedule(Packet &, uint64_t);
+    void advance(uint64_t);
+    uint64_t nextDeadline(void) const;
+    Packet* get(void);
+
+    bool empty(void) const
+    {
+        return !pkt_count && expired.head == NULL;
+    };
+
+    /* the packets not yet expired, counted in the queue limits */
+    uint32_t packets(void) const
+    {
+        return pkt_count;
+    };
+
+    uint32_t bytes(void) const
+    {
+        return pkt_bytes;
+    };
+};
+
+#endif /* SJ_TIMERWHEEL_H */
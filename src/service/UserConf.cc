@@ -407,6 +407,7 @@ bool UserConf::loadDiskConfiguration(void)
     parseMatch(runcfg.admin_address, "management-address", loadstream, cmdline_opts.admin_address, DEFAULT_ADMIN_ADDRESS);
     parseMatch(runcfg.admin_port, "management-port", loadstream, cmdline_opts.admin_port, DEFAULT_ADMIN_PORT);
     parseMatch(runcfg.chaining, "chaining", loadstream, cmdline_opts.chaining, DEFAULT_CHAINING);
+    parseMatch(runcfg.optimistic, "optimistic", loadstream, cmdline_opts.optimistic, DEFAULT_OPTIMISTIC);
     parseMatch(runcfg.no_tcp, "no-tcp", loadstream, cmdline_opts.no_tcp, DEFAULT_NO_TCP);
     parseMatch(runcfg.no_udp, "no-udp", loadstream, cmdline_opts.no_udp, DEFAULT_NO_UDP);
     parseMatch(runcfg.use_whitelist, "whitelist", loadstream, cmdline_opts.use_whitelist, DEFAULT_USE_WHITELIST);
@@ -416,6 +417,14 @@ bool UserConf::loadDiskConfiguration(void)
     parseMatch(runcfg.debug_level, "debug", loadstream, cmdline_opts.debug_level, DEFAULT_DEBUG_LEVEL);
     parseMatch(runcfg.onlyplugin, "only-plugin", loadstream, cmdline_opts.onlyplugin, DEFAULT_ONLYPLUGIN);
     parseMatch(runcfg.max_ttl_probe, "max-ttl-probe", loadstream, cmdline_opts.max_ttl_probe, DEFAULT_MAX_TTLPROBE);
+    parseMatch(runcfg.max_hold_ms, "max-hold-ms", loadstream, cmdline_opts.max_hold_ms, DEFAULT_MAX_HOLD_MS);
+    parseMatch(runcfg.pacing_us, "pacing", loadstream, cmdline_opts.pacing_us, DEFAULT_PACING_US);
+    parseMatch(runcfg.queue_limit, "queue-limit", loadstream, cmdline_opts.queue_limit, DEFAULT_QUEUE_LIMIT);
+    parseMatch(runcfg.queue_limit_kb, "queue-limit-kb", loadstream, cmdline_opts.queue_limit_kb, DEFAULT_QUEUE_LIMIT_KB);
+    parseMatch(runcfg.drop_tail, "drop-tail", loadstream, cmdline_opts.drop_tail, DEFAULT_DROP_TAIL);
+    parseMatch(runcfg.run_to_completion, "run-to-completion", loadstream, cmdline_opts.run_to_completion, DEFAULT_RUN_TO_COMPLETION);
+    parseMatch(runcfg.budget_percent, "budget-percent", loadstream, cmdline_opts.budget_percent, DEFAULT_BUDGET_PERCENT);
+    parseMatch(runcfg.budget_kbps, "budget-kbps", loadstream, cmdline_opts.budget_kbps, DEFAULT_BUDGET_KBPS);
     parseMatch(runcfg.gw_mac_str, "gw-mac-addr", loadstream, cmdline_opts.gw_mac_str, DEFAULT_GW_MAC_ADDR);
 
     /* loading of IP lists, in future also the source IP address should be useful */
@@ -556,6 +565,7 @@ bool UserConf::syncDiskConfiguration(void)
     written += dumpIfPresent(out, "management-address", runcfg.admin_address, DEFAULT_ADMIN_ADDRESS);
     written += dumpIfPresent(out, "management-port", runcfg.admin_port, DEFAULT_ADMIN_PORT);
     written += dumpIfPresent(out, "chaining", runcfg.chaining, DEFAULT_CHAINING);
+    written += dumpIfPresent(out, "optimistic", runcfg.optimistic, DEFAULT_OPTIMISTIC);
     written += dumpIfPresent(out, "no-tcp", runcfg.no_tcp, DEFAULT_NO_TCP);
     written += dumpIfPresent(out, "no-udp", runcfg.no_udp, DEFAULT_NO_UDP);
     written += dumpIfPresent(out, "whitelist", runcfg.use_whitelist, DEFAULT_USE_WHITELIST);
@@ -564,6 +574,14 @@ bool UserConf::syncDiskConfiguration(void)
     written += dumpIfPresent(out, "foreground", runcfg.go_foreground, DEFAULT_GO_FOREGROUND);
     written += dumpIfPresent(out, "debug", runcfg.debug_level, DEFAULT_DEBUG_LEVEL);
     written += dumpIfPresent(out, "max-ttl-probe", runcfg.max_ttl_probe, DEFAULT_MAX_TTLPROBE);
+    written += dumpIfPresent(out, "max-hold-ms", runcfg.max_hold_ms, DEFAULT_MAX_HOLD_MS);
+    written += dumpIfPresent(out, "pacing", runcfg.pacing_us, DEFAULT_PACING_US);
+    written += dumpIfPresent(out, "queue-limit", runcfg.queue_limit, DEFAULT_QUEUE_LIMIT);
+    written += dumpIfPresent(out, "queue-limit-kb", runcfg.queue_limit_kb, DEFAULT_QUEUE_LIMIT_KB);
+    written += dumpIfPresent(out, "drop-tail", runcfg.drop_tail, DEFAULT_DROP_TAIL);
+    written += dumpIfPresent(out, "run-to-completion", runcfg.run_to_completion, DEFAULT_RUN_TO_COMPLETION);
+    written += dumpIfPresent(out, "budget-percent", runcfg.budget_percent, DEFAULT_BUDGET_PERCENT);
+    written += dumpIfPresent(out, "budget-kbps", runcfg.budget_kbps, DEFAULT_BUDGET_KBPS);
 
     if (!syncPortsFiles() || !syncIPListsFiles())
     {
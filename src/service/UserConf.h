@@ -49,6 +49,7 @@ struct sj_cmdline_opts
     bool no_tcp;
     bool no_udp;
     bool chaining;
+    bool optimistic;
     bool use_whitelist;
     bool use_blacklist;
     bool active;
@@ -56,10 +57,19 @@ struct sj_cmdline_opts
     uint16_t debug_level;
     char onlyplugin[MEDIUMBUF];
     uint16_t max_ttl_probe;
+    uint16_t max_hold_ms;
+    uint16_t pacing_us;
+    uint16_t queue_limit;
+    uint16_t queue_limit_kb;
+    bool drop_tail;
+    bool run_to_completion;
+    uint16_t budget_percent;
+    uint16_t budget_kbps;
     char gw_mac_str[SMALLBUF];
     /* END OF COMMON PART WITH sj_config THAT WILL BE SAVED IN CONF FILE */
 
     bool force_restart;
+    uint32_t random_seed; /* 0 for a random seed */
 };
 
 /* this is the struct keeping the sniffjoke variables, is loaded
@@ -83,6 +93,7 @@ struct sj_config
     bool no_tcp;
     bool no_udp;
     bool chaining;
+    bool optimistic;
     bool use_whitelist;
     bool use_blacklist;
     bool active;
@@ -90,6 +101,14 @@ struct sj_config
     uint16_t debug_level;
     char onlyplugin[MEDIUMBUF];
     uint16_t max_ttl_probe;
+    uint16_t max_hold_ms;
+    uint16_t pacing_us;
+    uint16_t queue_limit;
+    uint16_t queue_limit_kb;
+    bool drop_tail;
+    bool run_to_completion;
+    uint16_t budget_percent;
+    uint16_t budget_kbps;
     char gw_mac_str[SMALLBUF];
     /* END OF COMMON PART WITH sj_cmdline_opts THAT WILL BE SAVED IN CONF FILE */
 
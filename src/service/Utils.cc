@@ -67,62 +67,6 @@ string execOSCmd(string cmd)
     return data;
 }
 
-void init_random()
-{
-    /* random pool initialization */
-    srandom(time(NULL));
-    for (uint8_t i = 0; i < ((uint8_t) random() % 10); ++i)
-        srandom(random());
-}
-
-void* memset_random(void *s, size_t n)
-{
-    /*
-     * highly optimized memset_random
-     *
-     * long int random(void).
-     *
-     * long int is variable on different architectures;
-     * for example on linux 64 bit is 8 chars long,
-     * so do a while using single chars its an inefficient choice.
-     *
-     */
-
-    if (debug.level() == TESTING_LEVEL)
-    {
-        memset(s, '6', n);
-    }
-    else
-    {
-        size_t longint = n / sizeof (long int);
-        size_t finalbytes = n % sizeof (long int);
-        unsigned char *cp = (unsigned char*) s;
-
-        while (longint-- > 0)
-        {
-            *((long int*) cp) = random();
-            cp += sizeof (long int);
-        }
-
-        while (finalbytes-- > 0)
-        {
-            *cp = (unsigned char) random();
-            ++cp;
-        }
-
-    }
-
-    return s;
-}
-
-bool random_percent(int32_t percent)
-{
-    if(debug.level() == TESTING_LEVEL)
-        return true;
-
-    return ( (random() % 100) + 1 <= percent );
-}
-
 int snprintfScramblesList(char *str, size_t size, uint8_t scramblesList)
 {
     int len = snprintf(str, size, "%s%s%s%s",
@@ -139,3 +83,13 @@ int snprintfScramblesList(char *str, size_t size, uint8_t scramblesList)
 
     return len;
 }
+
+/* the CLOCK_MONOTONIC in microseconds, sj_clock_us is updated with this */
+uint64_t monotonicClockUs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
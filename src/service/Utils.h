@@ -54,6 +54,7 @@ using namespace std;
 #include <sys/stat.h>
 
 #include "Debug.h"
+#include "Random.h"
 
 /*
  * there is a single clock in sniffjoke;
@@ -61,22 +62,21 @@ using namespace std;
  */
 extern time_t sj_clock;
 extern char sj_clock_str[MEDIUMBUF];
+extern uint64_t sj_clock_us; /* monotonic clock in microseconds, used for the short timings */
 
 #define ISSET_TTL(byte)         (byte & SCRAMBLE_TTL)
 #define ISSET_CHECKSUM(byte)    (byte & SCRAMBLE_CHECKSUM)
 #define ISSET_MALFORMED(byte)   (byte & SCRAMBLE_MALFORMED)
 #define ISSET_INNOCENT(byte)    (byte & SCRAMBLE_INNOCENT)
-#define RANDOM_IPOPT            ((random() % (LAST_IPOPT - FIRST_IPOPT )) + FIRST_IPOPT + 1)
-#define RANDOM_TCPOPT           ((random() % (LAST_TCPOPT - FIRST_TCPOPT )) + FIRST_TCPOPT + 1)
+#define RANDOM_IPOPT            ((sj_random() % (LAST_IPOPT - FIRST_IPOPT )) + FIRST_IPOPT + 1)
+#define RANDOM_TCPOPT           ((sj_random() % (LAST_TCPOPT - FIRST_TCPOPT )) + FIRST_TCPOPT + 1)
 
 /* std::runtime_error runtime_exception(const char *, const char *, uint32_t, const char *, ...); */
 std::runtime_error runtime_exception(const char *, const char *, ...);
 
 string execOSCmd(string cmd);
-void init_random(void);
-void* memset_random(void *, size_t);
 int snprintfScramblesList(char *str, size_t size, uint8_t scramblesList);
-bool random_percent(int32_t percent);
+uint64_t monotonicClockUs(void);
 
 #define SELFLOG(...) selflog(__func__, __VA_ARGS__)
 
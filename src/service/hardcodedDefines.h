@@ -41,6 +41,7 @@
 #define DEFAULT_ADMIN_ADDRESS   "127.0.0.1"
 #define DEFAULT_ADMIN_PORT      8844
 #define DEFAULT_CHAINING        false
+#define DEFAULT_OPTIMISTIC      false
 #define DEFAULT_NO_TCP          false
 #define DEFAULT_NO_UDP          false
 #define DEFAULT_USE_WHITELIST   false
@@ -52,6 +53,14 @@
 #define DEFAULT_ONLYPLUGIN      ""
 #define DEFAULT_DEBUG_LEVEL     2
 #define DEFAULT_MAX_TTLPROBE    35
+#define DEFAULT_MAX_HOLD_MS     0
+#define DEFAULT_PACING_US       0
+#define DEFAULT_QUEUE_LIMIT     0
+#define DEFAULT_QUEUE_LIMIT_KB  0
+#define DEFAULT_DROP_TAIL       false
+#define DEFAULT_RUN_TO_COMPLETION false
+#define DEFAULT_BUDGET_PERCENT  0
+#define DEFAULT_BUDGET_KBPS     0
 #define DEFAULT_GW_MAC_ADDR     ""
 
 /* this is not configurabile anyway in some (wrong) local network the
@@ -150,6 +159,8 @@
 #define AGG_N_LONGPEEK          "LONGPEEK"
 #define AGG_HANDSHAKE           4096
 #define AGG_N_HANDSHAKE         "HANDSHAKE"
+#define AGG_BULKDECAY           8192
+#define AGG_N_BULKDECAY         "BULKDECAY"
 
 /*
  * these are the IP/TCP options supported in detection, injection,
@@ -188,15 +199,29 @@
 #define SUPPORTED_OPTIONS           (LAST_TCPOPT + 1)
 
 #define NETIOBURSTSIZE                          10      /* 10 CYCLES OF I/O (10 in + 10 out pkts max) */
+#define PKTBATCH_SIZE                           64      /* packets received/analyzed together by NetIO and TCPTrack */
+#define SEND_DRR_BUCKETS                        64      /* flow buckets of the SEND scheduler, power of two */
+#define SEND_DRR_QUANTUM                        1500    /* bytes granted to a bucket for every round */
+#define SEND_BACKPRESSURE_PERCENT               75      /* tunnel not read over this % of the queue limits in SEND */
 #define SESSIONTRACKMAP_MANAGE_ROUTINE_TIMER    300     /* (5 MINUTES */
 #define TTLFOCUSMAP_MANAGE_ROUTINE_TIMER        3600    /* (1 HOUR) */
 #define SESSIONTRACK_EXPIRYTIME                 200     /* access expire time in seconds (5 MINUTES) */
 #define TTLFOCUS_EXPIRYTIME                     604800  /* access expire time in seconds (1 WEEK) */
 #define PLUGINHASH_EXPIRYTIME                   10      /* hash expire time in seconds since creation (10 SECONDS)*/
+#define PACKETFILTER_SLOTS                      8192    /* injected packets remembered by a filter generation, power of two */
 #define PLUGINCACHE_EXPIRYTIME                  200     /* access expire time in seconds (5 MINUTES) */
 #define TTLFOCUSMAP_MEMORY_THRESHOLD            1024    /* 1024 DESTINATIONS */
 #define SESSIONTRACKMAP_MEMORY_THRESHOLD        1024    /* 1024 TCP SESSIONS */
+#define BULKFLOW_MIN_BYTES                      1048576 /* a bulk flow has moved at least 1 MBYTE */
+#define BULKFLOW_MIN_SECONDS                    5       /* in at least 5 SECONDS */
+#define BULKFLOW_MIN_RATE                       32768   /* at 32 KBYTES per second or more */
+#define BULKDECAY_HALFLIFE_BYTES                1048576 /* BULKDECAY halves the aggressivity every 1 MBYTE */
+#define BUDGET_DEST_BURST                       16384   /* injection budget of a new destination (16 KBYTES) */
+#define BUDGET_GLOBAL_MIN_BURST                 3000    /* the global budget holds 1 second of kbps, at least 3000 bytes */
 #define TTLPROBE_RETRY_ON_UNKNOWN               600     /* schedule time on UNKNOWN TTL status (10 MINUTES) */
+#define RANDOMPOOL_SIZE                         65536   /* pre-generated random bytes (64 KBYTES) */
+#define RANDOMPOOL_REFILL_CHUNK                 4096    /* bytes generated for every idle cycle */
+#define RANDOMPOOL_RESEED_TIMER                 600     /* reseed from /dev/urandom (10 MINUTES) */
 
 /* enable the intensive debug: DEVELOPERS AND TESTER ONLY! */
 #if 0
@@ -36,6 +36,8 @@
 #define SHOWPORT_COMMAND_TYPE       8
 #define INFO_COMMAND_TYPE           9
 #define TTLMAP_COMMAND_TYPE        10
+#define HOLDSTAT_COMMAND_TYPE      11
+#define BUDGET_COMMAND_TYPE        12
 #define COMMAND_ERROR_MSG         100
 
 /* this contain the description of the entire block */
@@ -68,6 +70,7 @@ struct command_ret
 #define STAT_WHITELIST      19
 #define STAT_BLACKLIST      20
 #define STAT_ONLYP          21
+#define STAT_OPTIMISTIC     22
 
 /* and in SJStatus are used this struct for describe the single block */
 struct single_block
@@ -111,4 +114,22 @@ struct ttl_record
     uint8_t ttlestimate;
 };
 
+/* this struct is used for holdstat command handling,
+ * it contains a single bucket of the KEEP hold time histogram */
+struct hold_record
+{
+    uint32_t upto_ms; /* 0 in the last bucket: longer hold times */
+    uint32_t packets;
+};
+
+/* this struct is used for budget command handling: the first record is the
+ * global injection budget (daddr 0), then a record for every destination */
+struct budget_record
+{
+    uint32_t daddr;
+    uint32_t tokens; /* bytes that can be injected now */
+    uint32_t injected; /* bytes injected */
+    uint32_t refused; /* hacks not applied over the budget */
+};
+
 #endif /* SJ_INTERNALPROTOCOL_H */
@@ -21,6 +21,7 @@
  */
 
 #include "Utils.h"
+#include "Checksum.h"
 #include "UserConf.h"
 #include "SniffJoke.h"
 
@@ -53,12 +54,22 @@ static void sj_version(const char *pname)
     " --blacklist\t\tinject evasion packet in all session excluding the blacklisted ip address\n"\
     " --start\t\tif present, evasion i'ts activated immediatly [default: %s]\n"\
     " --chain\t\tenable chained hacking, powerful and entropic effects [default: %s]\n"\
+    " --optimistic\t\tdo not hold the packets of new destinations during the ttl bruteforce [default: %s]\n"\
     " --debug <level %d-%d>\tset verbosity level [default: %d]\n"\
     "\t\t\t%d: suppress log, %d: common, %d: verbose, %d: debug, %d: session %d: packets\n"\
     " --foreground\t\trunning in foreground [default:background]\n"\
     " --admin <ip>[:port]\tspecify administration IP address [default: %s:%d]\n"\
     " --force\t\tforce restart (usable when another sniffjoke service is running)\n"\
     " --gw-mac-addr\t\tspecify default gateway mac address [default: is autodetected]\n"\
+    " --max-hold-ms <ms>\tmax time a packet waits the ttl bruteforce, 0 is unlimited [default: %d]\n"\
+    " --pacing <us>\t\tspace the injected packets by up to <us> microseconds, 0 is disabled [default: %d]\n"\
+    " --queue-limit <n>\tmax packets in every internal queue, 0 is unlimited [default: %d]\n"\
+    " --queue-limit-kb <n>\tmax kilobytes in every internal queue, 0 is unlimited [default: %d]\n"\
+    " --drop-tail\t\tover the limits drop the last packet, not the injected ones first [default: %s]\n"\
+    " --run-to-completion\thack every packet when it is read, not in the queue sweeps [default: %s]\n"\
+    " --budget-percent <n>\tinjected bytes to a destination up to <n>%% of the real ones, 0 is unlimited [default: %d]\n"\
+    " --budget-kbps <n>\tinjected kilobits per second in total, 0 is unlimited [default: %d]\n"\
+    " --random-seed <n>\tuse a fixed random seed, making the hacks reproducible [default: random]\n"\
     " --version\t\tshow sniffjoke version\n"\
     " --help\t\t\tshow this help\n\n"\
     "\t\t\thttp://www.delirandom.net/sniffjoke\n"
@@ -74,9 +85,18 @@ static void sj_help(const char *pname)
            DEFAULT_NO_UDP ? "udp not mangled" : "udp mangled",
            DEFAULT_START_STOPPED ? "present" : "not present",
            DEFAULT_CHAINING ? "enabled" : "disabled",
+           DEFAULT_OPTIMISTIC ? "enabled" : "disabled",
            SUPPRESS_LEVEL, PACKET_LEVEL, DEFAULT_DEBUG_LEVEL,
            SUPPRESS_LEVEL, ALL_LEVEL, VERBOSE_LEVEL, DEBUG_LEVEL, SESSION_LEVEL, PACKET_LEVEL,
-           DEFAULT_ADMIN_ADDRESS, DEFAULT_ADMIN_PORT
+           DEFAULT_ADMIN_ADDRESS, DEFAULT_ADMIN_PORT,
+           DEFAULT_MAX_HOLD_MS,
+           DEFAULT_PACING_US,
+           DEFAULT_QUEUE_LIMIT,
+           DEFAULT_QUEUE_LIMIT_KB,
+           DEFAULT_DROP_TAIL ? "enabled" : "disabled",
+           DEFAULT_RUN_TO_COMPLETION ? "enabled" : "disabled",
+           DEFAULT_BUDGET_PERCENT,
+           DEFAULT_BUDGET_KBPS
            );
 }
 
@@ -98,6 +118,7 @@ int main(int argc, char **argv)
     /* ordered initialization of all boolean/uint values to the default */
     useropt.admin_port = DEFAULT_ADMIN_PORT;
     useropt.chaining = DEFAULT_CHAINING;
+    useropt.optimistic = DEFAULT_OPTIMISTIC;
     useropt.no_tcp = DEFAULT_NO_TCP;
     useropt.no_udp = DEFAULT_NO_UDP;
     useropt.use_whitelist = DEFAULT_USE_WHITELIST;
@@ -106,7 +127,16 @@ int main(int argc, char **argv)
     useropt.go_foreground = DEFAULT_GO_FOREGROUND;
     useropt.debug_level = DEFAULT_DEBUG_LEVEL;
     useropt.max_ttl_probe = DEFAULT_MAX_TTLPROBE;
+    useropt.max_hold_ms = DEFAULT_MAX_HOLD_MS;
+    useropt.pacing_us = DEFAULT_PACING_US;
+    useropt.queue_limit = DEFAULT_QUEUE_LIMIT;
+    useropt.queue_limit_kb = DEFAULT_QUEUE_LIMIT_KB;
+    useropt.drop_tail = DEFAULT_DROP_TAIL;
+    useropt.run_to_completion = DEFAULT_RUN_TO_COMPLETION;
+    useropt.budget_percent = DEFAULT_BUDGET_PERCENT;
+    useropt.budget_kbps = DEFAULT_BUDGET_KBPS;
     useropt.force_restart = false;
+    useropt.random_seed = 0;
 
     /*
      * no explicit inizialization needed for string values;
@@ -120,6 +150,7 @@ int main(int argc, char **argv)
         { "group", required_argument, NULL, 'g'},
         { "admin", required_argument, NULL, 'a'},
         { "chain", no_argument, NULL, 'c'},
+        { "optimistic", no_argument, NULL, 'O'},
         { "no-tcp", no_argument, NULL, 't'},
         { "no-udp", no_argument, NULL, 'l'},
         { "whitelist", no_argument, NULL, 'w'},
@@ -131,13 +162,22 @@ int main(int argc, char **argv)
         { "only-plugin", required_argument, NULL, 'p'}, /* not documented in --help */
         { "max-ttl-probe", required_argument, NULL, 'm'}, /* not documented too */
         { "gw-mac-addr", required_argument, NULL, 'e'},
+        { "max-hold-ms", required_argument, NULL, 'k'},
+        { "pacing", required_argument, NULL, 'P'},
+        { "queue-limit", required_argument, NULL, 'q'},
+        { "queue-limit-kb", required_argument, NULL, 'Q'},
+        { "drop-tail", no_argument, NULL, 'T'},
+        { "run-to-completion", no_argument, NULL, 'R'},
+        { "budget-percent", required_argument, NULL, 'B'},
+        { "budget-kbps", required_argument, NULL, 'K'},
+        { "random-seed", required_argument, NULL, 'n'},
         { "version", no_argument, NULL, 'v'},
         { "help", no_argument, NULL, 'h'},
         { NULL, 0, NULL, 0}
     };
 
     int charopt;
-    while ((charopt = getopt_long(argc, argv, "i:o:u:g:a:ctlwbsxrd:p:m:vh", sj_option, NULL)) != -1)
+    while ((charopt = getopt_long(argc, argv, "i:o:u:g:a:cOtlwbsxrd:p:m:k:P:q:Q:TRB:K:n:vh", sj_option, NULL)) != -1)
     {
         switch (charopt)
         {
@@ -172,6 +212,9 @@ int main(int argc, char **argv)
         case 'c':
             useropt.chaining = true;
             break;
+        case 'O':
+            useropt.optimistic = true;
+            break;
         case 't':
             useropt.no_tcp = true;
             break;
@@ -207,6 +250,33 @@ int main(int argc, char **argv)
         case 'm':
             useropt.max_ttl_probe = atoi(optarg);
             break;
+        case 'k':
+            useropt.max_hold_ms = atoi(optarg);
+            break;
+        case 'P':
+            useropt.pacing_us = atoi(optarg);
+            break;
+        case 'q':
+            useropt.queue_limit = atoi(optarg);
+            break;
+        case 'Q':
+            useropt.queue_limit_kb = atoi(optarg);
+            break;
+        case 'T':
+            useropt.drop_tail = true;
+            break;
+        case 'R':
+            useropt.run_to_completion = true;
+            break;
+        case 'B':
+            useropt.budget_percent = atoi(optarg);
+            break;
+        case 'K':
+            useropt.budget_kbps = atoi(optarg);
+            break;
+        case 'n':
+            useropt.random_seed = strtoul(optarg, NULL, 10);
+            break;
         case 'v':
             sj_version(argv[0]);
             return 0;
@@ -221,19 +291,25 @@ sniffjoke_help:
         }
     }
 
-    init_random();
+    init_random(useropt.random_seed);
+    init_checksum();
 
     try
     {
         sniffjoke = auto_ptr<SniffJoke > (new SniffJoke(useropt));
         sniffjoke->run();
 
+        /* the packets still queued refer to the session and ttl maps:
+         * they are released before the global maps are destroyed */
+        sniffjoke.reset();
+        clean_random();
     }
     catch (runtime_error &exception)
     {
         LOG_ALL("[runtime exception] going shutdown: %s", exception.what());
 
         sniffjoke.reset();
+        clean_random();
         return 0;
     }
 }